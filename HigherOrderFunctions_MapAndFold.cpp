@@ -174,6 +174,8 @@ int main() {
           [](int const i) { return i * i; },
           funclib::mapf([](int const i) { return std::abs(i); }, vnums)),
       0); // s = 236
+  // Each eager mapf above copies the whole vector just to be summed, the lazy
+  // mapf, filterf and fold in funclib.hpp avoid that, see the header.
   // As an exercise, we could implement the fold function as a variadic function
   // template, in the manner seen in a previous recipe. The function that
   // performs the actual folding is provided as an argument:
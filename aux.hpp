@@ -1,4 +1,10 @@
 #pragma once
+#include "format.hpp"
+#include "kernels.hpp"
+#include "radixSort.hpp"
+#include "sorting.hpp"
+#include "transducer.hpp"
+#include "variadic.hpp"
 #include "tiffio.h"
 #include <bitset>
 #include <cassert>
@@ -9,26 +15,25 @@
 #include <stdexcept>
 #include <unordered_map>
 template <typename... Ts> auto to_string(Ts &&... ts) {
-  std::ostringstream oss;
-  (oss << ... << std::forward<Ts>(ts));
-  return oss.str();
+  if constexpr ((Tesseract::is_chars_formattable_v<Ts> && ...)) {
+    auto s = std::string{}; // numbers and strings skip the stream entirely
+    Tesseract::format_to(s, ts...);
+    return s;
+  } else {
+    std::ostringstream oss;
+    (oss << ... << std::forward<Ts>(ts));
+    return oss.str();
+  }
 }
 // Fold expressions work with all overloads for the supported binary operators,
-// but do not work with arbitrary binary functions. It is possible to implement
-// a workaround for that by providing a wrapper type to hold a value and an
-// overloaded operator for that wrapper type:
-template <typename T> struct wrapper { T const &value; };
-
-template <typename T>
-constexpr auto operator<(wrapper<T> const &lhs, wrapper<T> const &rhs) {
-  return wrapper<T>{lhs.value < rhs.value ? lhs.value : rhs.value};
-}
-
+// but do not work with arbitrary binary functions. Instead of a wrapper type
+// holding references to the values, min and friends in variadic.hpp return
+// plain values and reduce homogeneous packs as a tree of selects:
 template <typename... Ts> constexpr auto min(Ts &&... args) {
-  return (wrapper<Ts>{args} < ...).value;
+  return Tesseract::variadic::min(args...);
 }
 
-auto m = min(1, 2, 3, 4, 5); // m = 1
+static_assert(min(1, 2, 3, 4, 5) == 1);
 //---------------------------------------------//-----------------------------------------------
 namespace Tesseract {
 
@@ -85,6 +90,22 @@ void shell_all(const T &container, std::ostream &os = std::cout) {
             std::ostream_iterator<typename T::value_type>{os, "\n"});
 }
 
+/*!
+ * \brief shell_all_bulk                Same output as shell_all for numbers and
+ *                                      strings, but formatted into a buffer
+ *                                      that is written once per 64 KiB
+ * \param container                     Container of numbers or strings
+ * \param os                            Arbitrary subclass of std::ostream
+ */
+template <typename T>
+void shell_all_bulk(const T &container, std::ostream &os = std::cout) {
+  auto sink = format_sink{os};
+  sink.precision(static_cast<int>(os.precision()));
+  sink("-- Shell all --\n");
+  for (auto const &x : container)
+    sink(x, '\n');
+}
+
 /*!
  * \brief shell_it                      Allows for formatted output of any
  * \param obj                           Object that defined an output operator
@@ -100,6 +121,8 @@ template <typename T> void shell_it(const T &obj) { // almost always auto
  * \param max               maximum value of the range to be transformed
  * \param new_max           a new maximum for the projection to the range, e.g.
  *                          new_max = 1 ranges the value in the unit intervall
+ *                          For whole arrays see scale, normalize and to_u8 in
+ *                          kernels.hpp, which avoid the division per value
  */
 static auto scaleValue(float min, float max, float new_max = 1) {
   const float diff{max - min};
@@ -111,6 +134,7 @@ static auto scaleValue(float min, float max, float new_max = 1) {
  * \brief clampValue        this function object builder limits values to the
  * \param min               specified minimum cut-off number and the
  * \param max               specified maximum cut-off number
+ *                          For whole arrays see clamp in kernels.hpp
  */
 static auto clampValue(float min, float max) {
   return [=](float val) -> float { return std::clamp(val, min, max); };
@@ -160,8 +184,8 @@ template <typename T>[[maybe_unused]] static auto within(T min, T max) {
  * \return                  True if all passed arguments are within bounds
  */
 template <typename T, typename... Ts>
-[[nodiscard]] bool allWithin(T min, T max, Ts... ts) {
-  return ((min <= ts && ts <= max) && ...);
+[[nodiscard]] constexpr bool allWithin(T min, T max, Ts... ts) {
+  return variadic::all_within(min, max, ts...);
 }
 
 /*!
@@ -213,17 +237,14 @@ template <typename T> void insertionSort(T start, T end) {
     std::rotate(std::upper_bound(start, i, *i), i, std::next(i));
 }
 
-template <class FwdIt, class Compare = std::less<>>
-void quickSort(FwdIt first, FwdIt last, Compare cmp = Compare{}) {
-  auto const N{std::distance(first, last)};
-  if (N <= 1)
-    return;
-  auto const pivot{std::next(first, N / 2)};
-  std::nth_element(first, pivot, last, cmp);
-  quickSort(first, pivot, cmp); // assert(std::is_sorted(first, pivot, cmp));
-  quickSort(pivot, last, cmp);  // assert(std::is_sorted(pivot, last, cmp));
-
-  // can be optimized by adding insertionSort call for small ranges
+/*!
+ * \brief quickSort                 Pattern-defeating quicksort, see pdqsort()
+ *                                  in sorting.hpp, parallel_pdqsort() sorts
+ *                                  big ranges on a thread_pool
+ */
+template <class RandIt, class Compare = std::less<>>
+void quickSort(RandIt first, RandIt last, Compare cmp = Compare{}) {
+  pdqsort(first, last, cmp);
 }
 
 template <typename I, typename P> auto stable_partition(I f, I l, P p) -> I {
@@ -273,28 +294,6 @@ static std::string trimLeft(const std::string &s) {
   return temp;
 }
 
-/*!
- * Transform_if implementation, TODO: A lot
- */
-template <typename T> auto map(T fn) {
-  return [=](auto reduce_fn) {
-    return [=](auto accum, auto input) { return reduce_fn(accum, fn(input)); };
-  };
-}
-
-template <typename T> auto filter(T predicate) {
-  return [=](auto accum, auto input) {
-    if (predicate(input)) {
-      return reduce_fn(accum, input);
-    } else {
-      return accum;
-    }
-  };
-};
-
-auto copy_and_advance{[](auto it, auto input) {
-  *it = input;
-  return ++it;
-}};
+// map, filter, take, partition_by, ... live in transducer.hpp
 
 } // namespace Tesseract
@@ -0,0 +1,265 @@
+#pragma once
+#include "threadPool.hpp"
+#include <algorithm>
+#include <bit>
+#include <cassert>
+#include <cmath>
+#include <complex>
+#include <cstddef>
+#include <numbers>
+#include <span>
+#include <stdexcept>
+#include <vector>
+
+namespace Tesseract {
+
+/*
+Digital beamforming of a uniform linear array. The input is one range-Doppler
+map per antenna channel, channel after channel, the output one map per angular
+beam, beam after beam, both with the same number of cells per map. Beam b looks
+at the direction with sine
+
+  u_b = (b - (beams - 1) / 2) / (beams * spacing)
+
+i.e. the beams are centered around broadside, spacing is in wavelengths. Two
+ways produce identical beams:
+
+  steering   precomputed beams x channels matrix times the channel maps, a
+             complex GEMM, works for any number of beams
+  fft        zero padded FFT across the channels, the centering becomes one
+             phase ramp over the channels, needs a power of two beams and at
+             most as many channels as beams
+
+Both run over blocks of cells that fit into L1, every inner loop walks along
+the cells of a map and vectorizes, the FFT even works in place in the output.
+Beams are plain sums, no taper is applied.
+*/
+
+enum class beamforming_method {
+  automatic, // whichever needs fewer complex multiplies
+  steering,
+  fft
+};
+
+/*!
+ * \brief beamformer        Turns channel maps into beam maps, all tables are
+ *                          computed once in the constructor
+ * \param channels          Number of antennas
+ * \param beams             Number of angular beams
+ * \param spacing           Antenna distance in wavelengths
+ * \param method            Throws std::invalid_argument if the FFT is asked
+ *                          for but cannot produce these beams
+ */
+class beamformer {
+public:
+  using value_type = std::complex<float>;
+
+  beamformer(std::size_t channels, std::size_t beams, double spacing = 0.5,
+             beamforming_method method = beamforming_method::automatic)
+      : channels_{channels}, beams_{beams}, spacing_{spacing} {
+    if (channels == 0 || beams == 0 || !(spacing > 0))
+      throw std::invalid_argument{"beamformer: empty array"};
+    auto const fft_possible = std::has_single_bit(beams) && channels <= beams;
+    if (method == beamforming_method::automatic)
+      method = fft_possible && channels + beams / 2 * std::bit_width(beams - 1) <
+                                   channels * beams
+                   ? beamforming_method::fft
+                   : beamforming_method::steering;
+    if (method == beamforming_method::fft && !fft_possible)
+      throw std::invalid_argument{"beamformer: no FFT for these beams"};
+    method_ = method;
+
+    auto const pi = std::numbers::pi;
+    auto const B = static_cast<double>(beams);
+    if (method_ == beamforming_method::steering) {
+      weights_.resize(beams * channels);
+      for (std::size_t b = 0; b < beams; ++b)
+        for (std::size_t c = 0; c < channels; ++c)
+          weights_[b * channels + c] = value_type(
+              std::polar(1.0, -2 * pi * spacing * static_cast<double>(c) *
+                                  sine(b)));
+    } else {
+      // u_b * spacing = b / B - (B - 1) / 2B, the second part is the ramp
+      ramp_.resize(channels);
+      for (std::size_t c = 0; c < channels; ++c)
+        ramp_[c] = value_type(
+            std::polar(1.0, pi * static_cast<double>(c) * (B - 1) / B));
+      twiddles_.resize(beams / 2);
+      for (std::size_t k = 0; k < beams / 2; ++k)
+        twiddles_[k] = value_type(
+            std::polar(1.0, -2 * pi * static_cast<double>(k) / B));
+    }
+    // a block of cells of every output (and for the GEMM input) row in L1
+    auto const rows = method_ == beamforming_method::fft ? beams : channels + 4;
+    block_ = std::max<std::size_t>(
+        16, (32768 / (rows * sizeof(value_type))) & ~std::size_t{15});
+  }
+
+  [[nodiscard]] std::size_t channels() const noexcept { return channels_; }
+  [[nodiscard]] std::size_t beams() const noexcept { return beams_; }
+  [[nodiscard]] beamforming_method method() const noexcept { return method_; }
+
+  // sine of the direction beam b looks at, beyond [-1, 1] it sees nothing
+  [[nodiscard]] double sine(std::size_t b) const noexcept {
+    auto const B = static_cast<double>(beams_);
+    return (static_cast<double>(b) - (B - 1) / 2) / (B * spacing_);
+  }
+
+  /*!
+   * \brief operator()      Forms all beams of all cells
+   * \param maps            channels() maps of equal size, one after another
+   * \param out             beams() maps of the same size, must not overlap
+   *                        the input
+   */
+  void operator()(std::span<value_type const> maps,
+                  std::span<value_type> out) const noexcept {
+    auto const cells = maps.size() / channels_;
+    assert(maps.size() == cells * channels_);
+    assert(out.size() >= cells * beams_);
+    form(maps.data(), out.data(), cells, 0, cells);
+  }
+
+  /*!
+   * \brief operator()      Same beams, the cells are split among the pool
+   * \param pool            Workers to run on, must not be the caller
+   */
+  void operator()(thread_pool &pool, std::span<value_type const> maps,
+                  std::span<value_type> out) const {
+    auto const cells = maps.size() / channels_;
+    assert(maps.size() == cells * channels_);
+    assert(out.size() >= cells * beams_);
+    auto const blocks = (cells + block_ - 1) / block_;
+    auto const tasks = std::min<std::size_t>(blocks, pool.size());
+    if (tasks <= 1)
+      return form(maps.data(), out.data(), cells, 0, cells);
+    task_group group{pool};
+    for (std::size_t t = 0; t < tasks; ++t)
+      group.run([=, this] {
+        auto const first = blocks * t / tasks * block_;
+        auto const last = std::min(blocks * (t + 1) / tasks * block_, cells);
+        form(maps.data(), out.data(), cells, first, last);
+      });
+  }
+
+private:
+  // cells [first, last) of every map
+  void form(value_type const *in, value_type *out, std::size_t cells,
+            std::size_t first, std::size_t last) const noexcept {
+    for (auto j = first; j < last; j += block_) {
+      auto const n = std::min(block_, last - j);
+      if (method_ == beamforming_method::fft)
+        fft_block(in + j, out + j, cells, n);
+      else
+        steering_block(in + j, out + j, cells, n);
+    }
+  }
+
+  // four beams at a time, so that every input value is loaded once per four
+  // beams, the first channel initializes the outputs
+  void steering_block(value_type const *in, value_type *out,
+                      std::size_t cells, std::size_t n) const noexcept {
+    constexpr std::size_t tile = 4;
+    auto b = std::size_t{0};
+    for (; b + tile <= beams_; b += tile)
+      steering_rows<tile>(in, out, cells, n, b);
+    for (; b < beams_; ++b)
+      steering_rows<1>(in, out, cells, n, b);
+  }
+
+  template <std::size_t K>
+  void steering_rows(value_type const *in, value_type *out, std::size_t cells,
+                     std::size_t n, std::size_t b) const noexcept {
+    auto const *const w = weights_.data() + b * channels_;
+    auto *const y = reinterpret_cast<float *>(out + b * cells);
+    cmul_rows<K, false>(reinterpret_cast<float const *>(in), w, channels_, y,
+                        2 * cells, n);
+    for (std::size_t c = 1; c < channels_; ++c)
+      cmul_rows<K, true>(reinterpret_cast<float const *>(in + c * cells),
+                         w + c, channels_, y, 2 * cells, n);
+  }
+
+  // radix 2, decimation in time: the ramped channels go to their bit reversed
+  // rows, the padding rows are zeroed, every butterfly then combines two
+  // whole rows and the beams come out in natural order
+  void fft_block(value_type const *in, value_type *out, std::size_t cells,
+                 std::size_t n) const noexcept {
+    auto const bits = static_cast<std::size_t>(std::bit_width(beams_)) - 1;
+    auto const reversed = [bits](std::size_t r) {
+      auto v = std::size_t{0};
+      for (std::size_t i = 0; i < bits; ++i, r >>= 1)
+        v = v << 1 | (r & 1);
+      return v;
+    };
+    for (std::size_t r = 0; r < beams_; ++r) {
+      auto *const y = reinterpret_cast<float *>(out + r * cells);
+      if (auto const c = reversed(r); c < channels_)
+        cmul(reinterpret_cast<float const *>(in + c * cells), ramp_[c], y, n);
+      else
+        std::fill(y, y + 2 * n, 0.F);
+    }
+    for (std::size_t half = 1; half < beams_; half *= 2)
+      for (std::size_t start = 0; start < beams_; start += 2 * half)
+        for (std::size_t k = 0; k < half; ++k)
+          butterfly(reinterpret_cast<float *>(out + (start + k) * cells),
+                    reinterpret_cast<float *>(out + (start + k + half) * cells),
+                    twiddles_[k * (beams_ / (2 * half))], n);
+  }
+
+  // the kernels work on interleaved floats, std::complex operators would
+  // check for NaNs and keep the loops scalar
+
+  // y = w x or y += w x for the first n values of K rows of y, the weights
+  // are w[0], w[w_stride], ...
+  template <std::size_t K, bool Accumulate>
+  static void cmul_rows(float const *__restrict x, value_type const *w,
+                        std::size_t w_stride, float *__restrict y,
+                        std::size_t y_stride, std::size_t n) noexcept {
+    float wr[K], wi[K];
+    for (std::size_t k = 0; k < K; ++k) {
+      wr[k] = w[k * w_stride].real();
+      wi[k] = w[k * w_stride].imag();
+    }
+    for (std::size_t j = 0; j < n; ++j) {
+      auto const xr = x[2 * j], xi = x[2 * j + 1];
+      for (std::size_t k = 0; k < K; ++k) {
+        auto *const yk = y + k * y_stride;
+        auto const re = wr[k] * xr - wi[k] * xi;
+        auto const im = wr[k] * xi + wi[k] * xr;
+        yk[2 * j] = Accumulate ? yk[2 * j] + re : re;
+        yk[2 * j + 1] = Accumulate ? yk[2 * j + 1] + im : im;
+      }
+    }
+  }
+
+  // y = w x
+  static void cmul(float const *__restrict x, value_type w,
+                   float *__restrict y, std::size_t n) noexcept {
+    cmul_rows<1, false>(x, &w, 0, y, 0, n);
+  }
+
+  // (a, b) = (a + w b, a - w b)
+  static void butterfly(float *__restrict a, float *__restrict b, value_type w,
+                        std::size_t n) noexcept {
+    auto const wr = w.real(), wi = w.imag();
+    for (std::size_t j = 0; j < n; ++j) {
+      auto const br = b[2 * j], bi = b[2 * j + 1];
+      auto const tr = wr * br - wi * bi, ti = wr * bi + wi * br;
+      auto const ar = a[2 * j], ai = a[2 * j + 1];
+      a[2 * j] = ar + tr;
+      a[2 * j + 1] = ai + ti;
+      b[2 * j] = ar - tr;
+      b[2 * j + 1] = ai - ti;
+    }
+  }
+
+  std::size_t channels_;
+  std::size_t beams_;
+  double spacing_;
+  beamforming_method method_;
+  std::size_t block_;
+  std::vector<value_type> weights_;  // steering, beams x channels
+  std::vector<value_type> ramp_;     // fft, per channel
+  std::vector<value_type> twiddles_; // fft, beams / 2
+};
+
+} // namespace Tesseract
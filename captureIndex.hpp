@@ -0,0 +1,445 @@
+#pragma once
+#include "fileScanner.hpp"
+#include "threadPool.hpp"
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <limits>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/inotify.h>
+#endif
+
+namespace Tesseract {
+
+/*
+Index of the capture files below a root directory, kept on disk between runs.
+A refresh walks the tree with one stat per entry and only reads the header of
+files whose size or mtime changed since the last run, a capture_watcher goes
+further and applies inotify events without walking anything. Queries by sensor
+and capture time are answered from per sensor arrays sorted by start time.
+*/
+
+/*!
+ * \brief capture_header    Fixed layout at the start of every capture file,
+ *                          stored in host byte order
+ */
+struct capture_header {
+  static constexpr std::array<char, 4> expected_magic{'R', 'C', 'A', 'P'};
+  static constexpr std::uint32_t current_version = 1;
+
+  std::array<char, 4> magic{expected_magic};
+  std::uint32_t version{current_version};
+  std::array<char, 16> sensor{}; // zero padded, e.g. "ARS300"
+  std::int64_t first_frame_ns{0};
+  std::int64_t last_frame_ns{0};
+  std::uint64_t frames{0};
+};
+
+inline std::optional<capture_header> read_capture_header(char const *path) {
+  int const fd = ::open(path, O_RDONLY | O_CLOEXEC);
+  if (fd < 0)
+    return std::nullopt;
+  auto header = capture_header{};
+  auto const n = ::pread(fd, &header, sizeof header, 0);
+  ::close(fd);
+  if (n != static_cast<::ssize_t>(sizeof header) ||
+      header.magic != capture_header::expected_magic ||
+      header.version != capture_header::current_version)
+    return std::nullopt;
+  return header;
+}
+
+struct capture_record {
+  std::string path;
+  std::uintmax_t size{0};
+  std::int64_t mtime_ns{0};
+  std::string sensor; // empty for files that are no captures
+  std::int64_t first_frame_ns{0};
+  std::int64_t last_frame_ns{0};
+  std::uint64_t frames{0};
+};
+
+struct refresh_stats {
+  std::size_t unchanged{0};
+  std::size_t updated{0}; // new or modified, header read
+  std::size_t removed{0};
+};
+
+/*!
+ * \brief capture_index     Path keyed index of capture files. Not thread
+ *                          safe, the pool overload of refresh() synchronizes
+ *                          its workers internally
+ * \param root              Directory to index recursively
+ * \param index_file        Where load() and save() keep the index, by
+ *                          default .capture_index inside root
+ */
+class capture_index {
+public:
+  explicit capture_index(std::string root, std::string index_file = {})
+      : root_{std::move(root)}, index_file_{std::move(index_file)} {
+    // scanned paths are root_ + '/' + name, so the index file only matches
+    // them if root_ has no trailing separator
+    while (root_.size() > 1 && root_.back() == '/')
+      root_.pop_back();
+    if (index_file_.empty())
+      index_file_ = (root_ == "/" ? "" : root_) + "/.capture_index";
+  }
+
+  [[nodiscard]] std::string const &root() const noexcept { return root_; }
+  [[nodiscard]] std::size_t size() const noexcept { return records_.size(); }
+
+  // false if there is no index file yet or it is unreadable, the index is
+  // empty then and the next refresh() reads every header once
+  bool load() {
+    records_.clear();
+    invalidate();
+    auto in = std::ifstream{index_file_, std::ios::binary};
+    std::uint64_t magic{0}, count{0};
+    if (!read(in, magic) || magic != file_magic || !read(in, count))
+      return false;
+    for (std::uint64_t i = 0; i < count; ++i) {
+      auto r = capture_record{};
+      if (!fields(r, [&in](auto &field) { return read(in, field); })) {
+        records_.clear();
+        return false;
+      }
+      auto path = r.path; // the right hand side is evaluated first
+      records_[std::move(path)] = {std::move(r), 0};
+    }
+    return true;
+  }
+
+  // written to a temporary first, so a crash never leaves a torn index
+  bool save() const {
+    auto const tmp = index_file_ + ".tmp";
+    {
+      auto out = std::ofstream{tmp, std::ios::binary | std::ios::trunc};
+      write(out, file_magic);
+      write(out, std::uint64_t{records_.size()});
+      for (auto const &[path, entry] : records_)
+        fields(entry.record, [&out](auto const &field) {
+          write(out, field);
+          return true;
+        });
+      if (!out.flush())
+        return false;
+    }
+    return std::rename(tmp.c_str(), index_file_.c_str()) == 0;
+  }
+
+  /*!
+   * \brief refresh         Brings the index up to date with the tree, only
+   *                        headers of new or modified files are read
+   */
+  refresh_stats refresh() {
+    auto stats = refresh_stats{};
+    ++generation_;
+    scan(root_, {}, [&](scan_entry const &e) { visit(e, stats); });
+    stats.removed = sweep();
+    return stats;
+  }
+
+  refresh_stats refresh(thread_pool &pool) {
+    auto stats = refresh_stats{};
+    auto mutex = std::mutex{};
+    ++generation_;
+    scan(pool, root_, {}, [&](scan_entry const &e) {
+      auto lock = std::unique_lock{mutex};
+      visit(e, stats, &lock);
+    });
+    stats.removed = sweep();
+    return stats;
+  }
+
+  // re-reads a single file after it changed, returns false if it is gone
+  bool update(std::string const &path) {
+    struct stat st;
+    // lstat like the scanner, a symlink is not a capture
+    if (::lstat(path.c_str(), &st) != 0 || !S_ISREG(st.st_mode)) {
+      erase(path);
+      return false;
+    }
+    auto e = scan_entry{};
+    e.path = path;
+    e.type = std::filesystem::file_type::regular;
+    e.size = static_cast<std::uintmax_t>(st.st_size);
+    e.mtime_ns =
+        std::int64_t{st.st_mtim.tv_sec} * 1'000'000'000 + st.st_mtim.tv_nsec;
+    auto stats = refresh_stats{};
+    visit(e, stats);
+    return true;
+  }
+
+  // removes path and, if it was a directory, everything below it
+  std::size_t erase(std::string const &path) {
+    auto const dir = path + '/';
+    auto const n = std::erase_if(records_, [&](auto const &kv) {
+      return kv.first == path || kv.first.starts_with(dir);
+    });
+    if (n)
+      invalidate();
+    return n;
+  }
+
+  /*!
+   * \brief query           All captures of the sensor whose recording time
+   *                        overlaps [t0, t1], ordered by start time
+   */
+  [[nodiscard]] std::vector<capture_record const *>
+  query(std::string_view sensor, std::int64_t t0, std::int64_t t1) const {
+    build_sensor_index();
+    auto result = std::vector<capture_record const *>{};
+    auto const it = by_sensor_.find(std::string{sensor});
+    if (it == by_sensor_.end())
+      return result;
+    auto const &[records, max_duration] = it->second;
+    // nothing that starts before t0 - max_duration can reach t0
+    auto const earliest = t0 < std::numeric_limits<std::int64_t>::min() +
+                                   max_duration
+                              ? std::numeric_limits<std::int64_t>::min()
+                              : t0 - max_duration;
+    auto first = std::lower_bound(
+        records.begin(), records.end(), earliest,
+        [](auto const *r, std::int64_t t) { return r->first_frame_ns < t; });
+    for (; first != records.end() && (*first)->first_frame_ns <= t1; ++first)
+      if ((*first)->last_frame_ns >= t0)
+        result.push_back(*first);
+    return result;
+  }
+
+  [[nodiscard]] capture_record const *find(std::string const &path) const {
+    auto const it = records_.find(path);
+    return it == records_.end() ? nullptr : &it->second.record;
+  }
+
+private:
+  static constexpr std::uint64_t file_magic = 0x3158444943504143; // CAPCIDX1
+
+  struct entry {
+    capture_record record;
+    std::uint64_t generation;
+  };
+
+  struct sensor_index {
+    std::vector<capture_record const *> records;
+    std::int64_t max_duration{0};
+  };
+
+  // the header is read without holding the lock of a parallel refresh
+  void visit(scan_entry const &e, refresh_stats &stats,
+             std::unique_lock<std::mutex> *lock = nullptr) {
+    if (e.type != std::filesystem::file_type::regular ||
+        e.path == index_file_ || e.path == index_file_ + ".tmp")
+      return;
+    auto const path = std::string{e.path};
+    if (auto it = records_.find(path); it != records_.end() &&
+                                       it->second.record.size == e.size &&
+                                       it->second.record.mtime_ns ==
+                                           e.mtime_ns) {
+      it->second.generation = generation_;
+      ++stats.unchanged;
+      return;
+    }
+    auto r = capture_record{};
+    r.path = path;
+    r.size = e.size;
+    r.mtime_ns = e.mtime_ns;
+    if (lock)
+      lock->unlock();
+    if (auto const header = read_capture_header(path.c_str())) {
+      auto const &s = header->sensor;
+      r.sensor.assign(s.data(), std::find(s.begin(), s.end(), '\0'));
+      r.first_frame_ns = header->first_frame_ns;
+      r.last_frame_ns = header->last_frame_ns;
+      r.frames = header->frames;
+    }
+    if (lock)
+      lock->lock();
+    records_[path] = {std::move(r), generation_};
+    ++stats.updated;
+    invalidate();
+  }
+
+  std::size_t sweep() {
+    auto const n = std::erase_if(records_, [this](auto const &kv) {
+      return kv.second.generation != generation_;
+    });
+    if (n)
+      invalidate();
+    return n;
+  }
+
+  void invalidate() noexcept { sensor_index_valid_ = false; }
+
+  void build_sensor_index() const {
+    if (sensor_index_valid_)
+      return;
+    by_sensor_.clear();
+    for (auto const &[path, entry] : records_) {
+      auto const &r = entry.record;
+      if (r.sensor.empty())
+        continue;
+      auto &s = by_sensor_[r.sensor];
+      s.records.push_back(&r);
+      s.max_duration =
+          std::max(s.max_duration, r.last_frame_ns - r.first_frame_ns);
+    }
+    for (auto &[sensor, s] : by_sensor_)
+      std::sort(s.records.begin(), s.records.end(),
+                [](auto const *a, auto const *b) {
+                  return a->first_frame_ns < b->first_frame_ns;
+                });
+    sensor_index_valid_ = true;
+  }
+
+  // the on-disk layout of a record, in order
+  template <typename R, typename F> static bool fields(R &r, F f) {
+    return f(r.path) && f(r.size) && f(r.mtime_ns) && f(r.sensor) &&
+           f(r.first_frame_ns) && f(r.last_frame_ns) && f(r.frames);
+  }
+
+  template <typename T> static bool read(std::istream &in, T &value) {
+    if constexpr (std::is_same_v<T, std::string>) {
+      std::uint32_t n{0};
+      if (!read(in, n))
+        return false;
+      value.resize(n);
+      return static_cast<bool>(in.read(value.data(), n));
+    } else {
+      return static_cast<bool>(
+          in.read(reinterpret_cast<char *>(&value), sizeof value));
+    }
+  }
+
+  template <typename T> static void write(std::ostream &out, T const &value) {
+    if constexpr (std::is_same_v<T, std::string>) {
+      write(out, static_cast<std::uint32_t>(value.size()));
+      out.write(value.data(), static_cast<std::streamsize>(value.size()));
+    } else {
+      out.write(reinterpret_cast<char const *>(&value), sizeof value);
+    }
+  }
+
+  std::string root_;
+  std::string index_file_;
+  std::unordered_map<std::string, entry> records_;
+  std::uint64_t generation_{0};
+  mutable std::unordered_map<std::string, sensor_index> by_sensor_;
+  mutable bool sensor_index_valid_{false};
+};
+
+#ifdef __linux__
+/*!
+ * \brief capture_watcher   Keeps a capture_index current from inotify events
+ *                          instead of rescans. Watches every directory below
+ *                          the root, including ones created later on
+ */
+class capture_watcher {
+public:
+  explicit capture_watcher(capture_index &index)
+      : index_{index}, fd_{::inotify_init1(IN_NONBLOCK | IN_CLOEXEC)} {
+    if (fd_ >= 0)
+      watch_tree(index_.root());
+  }
+  capture_watcher(capture_watcher const &) = delete;
+  capture_watcher &operator=(capture_watcher const &) = delete;
+  ~capture_watcher() {
+    if (fd_ >= 0)
+      ::close(fd_);
+  }
+
+  [[nodiscard]] bool valid() const noexcept { return fd_ >= 0; }
+
+  // to wait for events with poll(2) or epoll alongside other descriptors
+  [[nodiscard]] int native_handle() const noexcept { return fd_; }
+
+  /*!
+   * \brief poll            Applies all pending events to the index without
+   *                        blocking and returns how many there were
+   */
+  std::size_t poll() {
+    alignas(inotify_event) char buffer[1 << 14];
+    std::size_t events{0};
+    for (;;) {
+      auto const n = ::read(fd_, buffer, sizeof buffer);
+      if (n <= 0)
+        return events;
+      for (auto *p = buffer; p < buffer + n;) {
+        auto const *const ev = reinterpret_cast<inotify_event const *>(p);
+        apply(*ev);
+        ++events;
+        p += sizeof(inotify_event) + ev->len;
+      }
+    }
+  }
+
+private:
+  static constexpr std::uint32_t mask = IN_CLOSE_WRITE | IN_MOVED_TO |
+                                        IN_MOVED_FROM | IN_DELETE |
+                                        IN_CREATE | IN_DELETE_SELF;
+
+  void watch(std::string const &dir) {
+    int const wd = ::inotify_add_watch(fd_, dir.c_str(), mask | IN_ONLYDIR);
+    if (wd >= 0)
+      dirs_[wd] = dir;
+  }
+
+  void watch_tree(std::string const &root) {
+    watch(root);
+    scan(root, {true, false}, [this](scan_entry const &e) {
+      if (e.type == std::filesystem::file_type::directory)
+        watch(std::string{e.path});
+    });
+  }
+
+  void apply(inotify_event const &ev) {
+    if (ev.mask & IN_Q_OVERFLOW) { // events were lost
+      index_.refresh();
+      return;
+    }
+    if (ev.mask & IN_IGNORED) {
+      dirs_.erase(ev.wd);
+      return;
+    }
+    auto const dir = dirs_.find(ev.wd);
+    if (dir == dirs_.end() || ev.len == 0)
+      return;
+    auto const path = dir->second + '/' + ev.name;
+    if (ev.mask & IN_ISDIR) {
+      if (ev.mask & (IN_CREATE | IN_MOVED_TO)) {
+        // files may have landed before the watch existed
+        watch_tree(path);
+        scan(path, {}, [this](scan_entry const &e) {
+          if (e.type == std::filesystem::file_type::regular)
+            index_.update(std::string{e.path});
+        });
+      } else if (ev.mask & (IN_DELETE | IN_MOVED_FROM)) {
+        index_.erase(path);
+      }
+    } else if (ev.mask & (IN_CLOSE_WRITE | IN_MOVED_TO)) {
+      index_.update(path);
+    } else if (ev.mask & (IN_DELETE | IN_MOVED_FROM)) {
+      index_.erase(path);
+    }
+  }
+
+  capture_index &index_;
+  int fd_;
+  std::unordered_map<int, std::string> dirs_;
+};
+#endif
+
+} // namespace Tesseract
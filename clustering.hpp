@@ -0,0 +1,272 @@
+#pragma once
+#include "SI-lib.hpp"
+#include "spatialIndex.hpp"
+#include "threadPool.hpp"
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <span>
+#include <utility>
+#include <vector>
+
+namespace Tesseract {
+
+/*
+DBSCAN over the detections of a frame, given in range and azimuth. The
+neighborhoods come from a polar uniform_grid, a detection with at least
+min_points detections within the gates (itself included) is a core point,
+core points that are neighbors end up in the same cluster and every other
+detection joins the cluster of its first core neighbor or stays noise.
+
+Instead of growing clusters point by point with a queue, core neighbors are
+united in a union-find forest (path halving, the smaller index becomes the
+root), so each detection is looked at a constant number of times. The
+parallel overload cuts the detections into range tiles: every worker unites
+only detections of its own tile, which touches only its own part of the
+forest, and collects the edges crossing a tile border, those are merged
+afterwards. Labels and clusters are numbered in detection order, hence the
+result does not depend on the number of threads.
+*/
+
+/*!
+ * \brief cluster           Compact descriptor of one cluster, centroid is the
+ *                          mean, extent is max - min per axis
+ */
+struct cluster {
+  std::uint32_t size{0};
+  Length range{};
+  DimensionlessQuantity azimuth{}; // radians
+  Length range_extent{};
+  DimensionlessQuantity azimuth_extent{};
+};
+
+struct clustering {
+  static constexpr std::int32_t noise = -1;
+
+  std::vector<std::int32_t> labels; // cluster of every detection, or noise
+  std::vector<cluster> clusters;
+};
+
+/*!
+ * \brief dbscan            Reusable clustering stage, keeps its buffers from
+ *                          frame to frame
+ * \param grid              Polar grid whose radius and scale are the gates
+ * \param min_points        Neighbors, including itself, that make a core
+ */
+class dbscan {
+public:
+  explicit dbscan(uniform_grid grid, std::size_t min_points = 3)
+      : grid_{std::move(grid)}, min_points_{min_points} {}
+
+  /*!
+   * \brief for_sensor      Clusters detections within range_gate metres and
+   *                        angle_gate radians of each other, by default one
+   *                        range cell of the sensor
+   */
+  template <typename Sensor>
+  static dbscan for_sensor(Sensor const &sensor, std::size_t min_points = 3,
+                           float range_gate = 0, float angle_gate = 0.05F) {
+    return dbscan{uniform_grid::polar(sensor, range_gate, angle_gate),
+                  min_points};
+  }
+
+  /*!
+   * \brief operator()      Clusters one frame
+   * \param detections      x is the range in metres, y the azimuth in radians
+   * \return                Valid until the next call
+   */
+  clustering const &operator()(point_set detections) {
+    return run(nullptr, detections);
+  }
+
+  // same result, the tiles are processed on the pool
+  clustering const &operator()(thread_pool &pool, point_set detections) {
+    return run(&pool, detections);
+  }
+
+private:
+  static constexpr auto none = std::numeric_limits<std::uint32_t>::max();
+
+  clustering const &run(thread_pool *pool, point_set detections) {
+    auto const n = detections.size();
+    grid_.rebuild(detections);
+    core_.assign(n, 0);
+    parent_.resize(n);
+    for (std::size_t i = 0; i < n; ++i)
+      parent_[i] = static_cast<std::uint32_t>(i);
+
+    auto const tiles =
+        pool ? std::clamp<std::size_t>(n / 1024, 1, pool->size()) : 1;
+    assign_tiles(detections, tiles);
+    auto const in_parallel = [&](auto const &f) {
+      if (tiles == 1)
+        return f(0);
+      task_group group{*pool};
+      for (std::size_t t = 0; t < tiles; ++t)
+        group.run([&f, t] { f(t); });
+      group.wait();
+    };
+
+    in_parallel([&](std::size_t t) { find_cores(detections, t); });
+    in_parallel([&](std::size_t t) { unite_tile(detections, t); });
+    for (auto const &edges : crossing_)
+      for (auto const &[a, b] : edges)
+        unite(a, b);
+    for (std::size_t i = 0; i < n; ++i) // flat, from here on read only
+      parent_[i] = find(static_cast<std::uint32_t>(i));
+    in_parallel([&](std::size_t t) { attach_borders(detections, t); });
+    describe(detections);
+    return result_;
+  }
+
+  // range strips of about equal width, the detections of tile t are
+  // members_[first_[t], first_[t + 1])
+  void assign_tiles(point_set detections, std::size_t tiles) {
+    auto const n = detections.size();
+    tile_.resize(n);
+    first_.assign(tiles + 1, 0);
+    crossing_.resize(tiles);
+    for (auto &edges : crossing_)
+      edges.clear();
+    auto lo = std::numeric_limits<float>::max(), hi = -lo;
+    for (auto const r : detections.x) {
+      lo = std::min(lo, r);
+      hi = std::max(hi, r);
+    }
+    auto const width = (hi - lo) / static_cast<float>(tiles);
+    for (std::size_t i = 0; i < n; ++i) {
+      auto const t = width > 0 ? static_cast<std::size_t>(
+                                     (detections.x[i] - lo) / width)
+                               : 0;
+      tile_[i] = static_cast<std::uint32_t>(std::min(t, tiles - 1));
+      ++first_[tile_[i] + 1];
+    }
+    for (std::size_t t = 0; t < tiles; ++t)
+      first_[t + 1] += first_[t];
+    members_.resize(n);
+    auto fill = first_;
+    for (std::size_t i = 0; i < n; ++i)
+      members_[fill[tile_[i]]++] = static_cast<std::uint32_t>(i);
+  }
+
+  [[nodiscard]] std::span<std::uint32_t const>
+  tile(std::size_t t) const noexcept {
+    return {members_.data() + first_[t], members_.data() + first_[t + 1]};
+  }
+
+  void find_cores(point_set detections, std::size_t t) {
+    for (auto const i : tile(t)) {
+      auto count = std::size_t{0};
+      grid_.for_each_neighbor(detections.x[i], detections.y[i],
+                              [&count](std::uint32_t, float) { ++count; });
+      core_[i] = count >= min_points_;
+    }
+  }
+
+  void unite_tile(point_set detections, std::size_t t) {
+    auto &crossing = crossing_[t];
+    for (auto const i : tile(t)) {
+      if (!core_[i])
+        continue;
+      grid_.for_each_neighbor(
+          detections.x[i], detections.y[i], [&](std::uint32_t j, float) {
+            if (!core_[j] || j == i)
+              return;
+            if (tile_[j] == t)
+              unite(i, j);
+            else if (i < j) // the other tile sees the same edge
+              crossing.emplace_back(i, j);
+          });
+    }
+  }
+
+  // borders point at the root of their first core neighbor, noise at none
+  void attach_borders(point_set detections, std::size_t t) {
+    for (auto const i : tile(t)) {
+      if (core_[i])
+        continue;
+      auto root = none;
+      grid_.for_each_neighbor(detections.x[i], detections.y[i],
+                              [&](std::uint32_t j, float) {
+                                if (root == none && core_[j])
+                                  root = parent_[j];
+                              });
+      parent_[i] = root;
+    }
+  }
+
+  // clusters are numbered by their first detection
+  void describe(point_set detections) {
+    auto const n = detections.size();
+    auto &labels = result_.labels;
+    auto &clusters = result_.clusters;
+    labels.assign(n, clustering::noise);
+    clusters.clear();
+    bounds_.clear();
+    for (std::size_t i = 0; i < n; ++i) {
+      auto const root = parent_[i];
+      if (root == none)
+        continue;
+      // the root of a border may come later, it is labelled right away
+      if (labels[root] == clustering::noise) {
+        labels[root] = static_cast<std::int32_t>(clusters.size());
+        clusters.emplace_back();
+        bounds_.push_back({detections.x[i], detections.x[i], detections.y[i],
+                           detections.y[i], 0, 0});
+      }
+      auto const label = labels[i] = labels[root];
+      auto &b = bounds_[static_cast<std::size_t>(label)];
+      auto const r = detections.x[i], a = detections.y[i];
+      b.range_lo = std::min(b.range_lo, r);
+      b.range_hi = std::max(b.range_hi, r);
+      b.azimuth_lo = std::min(b.azimuth_lo, a);
+      b.azimuth_hi = std::max(b.azimuth_hi, a);
+      b.range_sum += r;
+      b.azimuth_sum += a;
+      ++clusters[static_cast<std::size_t>(label)].size;
+    }
+    for (std::size_t c = 0; c < clusters.size(); ++c) {
+      auto &k = clusters[c];
+      auto const &b = bounds_[c];
+      k.range = Length{b.range_sum / k.size};
+      k.azimuth = DimensionlessQuantity{b.azimuth_sum / k.size};
+      k.range_extent =
+          Length{static_cast<long double>(b.range_hi) - b.range_lo};
+      k.azimuth_extent =
+          DimensionlessQuantity{static_cast<long double>(b.azimuth_hi) -
+                                b.azimuth_lo};
+    }
+  }
+
+  std::uint32_t find(std::uint32_t i) noexcept {
+    while (parent_[i] != i)
+      i = parent_[i] = parent_[parent_[i]];
+    return i;
+  }
+
+  void unite(std::uint32_t a, std::uint32_t b) noexcept {
+    a = find(a);
+    b = find(b);
+    if (a != b)
+      parent_[std::max(a, b)] = std::min(a, b);
+  }
+
+  struct bounds {
+    float range_lo, range_hi, azimuth_lo, azimuth_hi;
+    long double range_sum, azimuth_sum;
+  };
+
+  uniform_grid grid_;
+  std::size_t min_points_;
+  std::vector<std::uint8_t> core_;
+  std::vector<std::uint32_t> parent_; // union-find, later the cluster root
+  std::vector<std::uint32_t> tile_;
+  std::vector<std::uint32_t> first_;
+  std::vector<std::uint32_t> members_; // detections sorted by tile
+  std::vector<std::vector<std::pair<std::uint32_t, std::uint32_t>>> crossing_;
+  std::vector<bounds> bounds_;
+  clustering result_;
+};
+
+} // namespace Tesseract
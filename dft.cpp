@@ -1,8 +1,11 @@
+#include "format.hpp"
+#include "frameArena.hpp"
 #include <algorithm>
 #include <cmath>
 #include <complex>
 #include <iostream>
 #include <iterator>
+#include <memory_resource>
 #include <numeric>
 #include <vector>
 
@@ -22,8 +25,13 @@ public:
 
 using cmplx = std::complex<double>;
 using csignal = std::vector<cmplx>;
+namespace pmr {
+using csignal = std::pmr::vector<cmplx>; // e.g. from a Tesseract::frame_arena
+}
 
-[[nodiscard]] csignal fourier_transform(csignal const &input_signal, bool back = false) {
+// the result is allocated like the input, i.e. in the same arena
+template <typename Signal = csignal>
+[[nodiscard]] Signal fourier_transform(Signal const &input_signal, bool back = false) {
   auto const pol = 2.0 * M_PI * (back ? -1.0 : 1.0);
   auto const N = back ? 1.0 : static_cast<double>(std::size(input_signal));
 
@@ -40,7 +48,8 @@ using csignal = std::vector<cmplx>;
                            sum_up(k)) / N;
   };
 
-  auto output_signal = csignal(std::size(input_signal));
+  auto output_signal =
+      Signal(std::size(input_signal), input_signal.get_allocator());
   std::transform(num_iterator{0}, num_iterator{std::size(input_signal)}, std::begin(output_signal),
                  to_ft);
   return output_signal;
@@ -61,22 +70,28 @@ auto gen_square_wave(std::uint64_t period_length) {
   };
 }
 
-template <typename F>
-auto signal_from_generator(std::uint64_t sample_size, F gen) {
-  auto input_signal = csignal(sample_size);
+template <typename F, typename Allocator = std::allocator<cmplx>>
+auto signal_from_generator(std::uint64_t sample_size, F gen,
+                           Allocator allocator = {}) {
+  auto input_signal = std::vector<cmplx, Allocator>(sample_size, allocator);
   std::generate(std::begin(input_signal), std::end(input_signal), gen);
   return input_signal;
 }
 
+// formatted with std::to_chars into one buffer and written at once instead
+// of streaming every double on its own, same output as ostream_iterator
  void print_signal(const csignal &s) {
-  auto real_val = [](cmplx c) { return c.real(); };
-  transform(begin(s), end(s), std::ostream_iterator<double>{std::cout, " "},
-            real_val);
-  std::cout << '\n';
+  auto sink = Tesseract::format_sink{std::cout};
+  sink.precision(static_cast<int>(std::cout.precision()));
+  for (auto const &c : s)
+    sink(c.real(), ' ');
+  sink('\n');
 }
 
 }
 
+TESSERACT_COUNT_ALLOCATIONS
+
 int main() {
 
   auto const sample_size = 100u;
@@ -92,6 +107,24 @@ int main() {
   auto mid = fourier_transform(trans_sqw, true);
   print_signal(cosine);
   print_signal(fourier_transform(cosine));
+
+  // one arena per frame loop, after the first frames nothing touches the heap
+  auto arena = Tesseract::frame_arena{1 << 10};
+  auto heap_before = std::size_t{0};
+  for (auto frame = 0; frame < 100; ++frame) {
+    if (frame == 2)
+      heap_before = Tesseract::heap_allocations;
+    {
+      auto const input = signal_from_generator(
+          sample_size, gen_cosine(period_length), arena.allocator<cmplx>());
+      auto const spectrum = fourier_transform(input);
+      auto const output = fourier_transform(spectrum, true);
+    }
+    arena.reset();
+  }
+  std::cout << Tesseract::heap_allocations - heap_before
+            << " heap allocations in 98 steady state frames, arena of "
+            << arena.capacity() << " bytes\n";
 #if 0
   print_signal(mid);
   print_signal(trans_sqw);
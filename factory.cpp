@@ -1,5 +1,6 @@
-#include <functional>
-#include <map>
+#include "objectPool.hpp"
+#include "registry.hpp"
+#include <iostream>
 #include <memory>
 #include <string>
 #include <string_view>
@@ -14,19 +15,65 @@ struct IImageFactory {
 };
 
 struct ImageFactory : IImageFactory {
-  std::shared_ptr<Image> Create(std::string_view type) const final {
-    static std::map<std::string, std::function<std::shared_ptr<Image>()>>
-        mapping{{"bmp", [] { return std::make_shared<BitmapImage>(); }},
-                {"png", [] { return std::make_shared<PngImage>(); }},
-                {"jpg", [] { return std::make_shared<JpgImage>(); }}};
+  using creator_t = std::shared_ptr<Image> (*)();
+
+  // perfect hash built by the compiler, a lookup is one hash and one compare
+  // and works for any string_view, NUL terminated or not
+  static constexpr auto mapping = Tesseract::make_static_registry<creator_t>(
+      {{"bmp", []() -> std::shared_ptr<Image> {
+          return std::make_shared<BitmapImage>();
+        }},
+       {"png", []() -> std::shared_ptr<Image> {
+          return std::make_shared<PngImage>();
+        }},
+       {"jpg", []() -> std::shared_ptr<Image> {
+          return std::make_shared<JpgImage>();
+        }}});
 
-    if (auto it = mapping.find(std::data(type)); it != mapping.end())
-      return it->second();
+  std::shared_ptr<Image> Create(std::string_view type) const final {
+    if (auto const *create = mapping.find(type))
+      return (*create)();
     return nullptr;
   }
 };
 
+// same products without make_shared: every type has a pool, dropping an image
+// hands its storage back, so steady state creation does not allocate
+struct PooledImageFactory {
+  Tesseract::object_pool<BitmapImage> bitmaps_;
+  Tesseract::object_pool<PngImage> pngs_;
+  Tesseract::object_pool<JpgImage> jpgs_;
+
+  using creator_t = Tesseract::pool_ptr<Image> (*)(PooledImageFactory &);
+
+  static constexpr auto mapping = Tesseract::make_static_registry<creator_t>(
+      {{"bmp", [](PooledImageFactory &f) -> Tesseract::pool_ptr<Image> {
+          return f.bitmaps_.acquire();
+        }},
+       {"png", [](PooledImageFactory &f) -> Tesseract::pool_ptr<Image> {
+          return f.pngs_.acquire();
+        }},
+       {"jpg", [](PooledImageFactory &f) -> Tesseract::pool_ptr<Image> {
+          return f.jpgs_.acquire();
+        }}});
+
+  Tesseract::pool_ptr<Image> Create(std::string_view type) {
+    if (auto const *create = mapping.find(type))
+      return (*create)(*this);
+    return {};
+  }
+};
+
 int main() {
   auto factory = ImageFactory{};
   auto image = factory.Create("png");
+
+  auto pooled = PooledImageFactory{};
+  for (auto frame = 0; frame < 1000; ++frame) {
+    auto a = pooled.Create("png");
+    auto b = pooled.Create("jpg");
+  }
+  auto const stats = pooled.pngs_.stats();
+  std::cout << "png pool: " << stats.hits << " hits, " << stats.misses
+            << " misses, " << stats.capacity << " slots\n";
 }
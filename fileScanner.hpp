@@ -0,0 +1,205 @@
+#pragma once
+#include "threadPool.hpp"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <limits>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace Tesseract {
+
+/*
+Directory traversal on top of openat/readdir instead of std::filesystem, which
+stats every entry at least once for the iterator and once more for each
+status() or file_size() query. Here the type comes for free from the d_type
+field of the directory entry, and with scan_options::stat a single fstatat()
+relative to the open directory fills in size, mode and mtime. Entries are
+handed to a callback as soon as they are read, nothing is collected. The
+parallel overload scans every subdirectory as a task of its own.
+*/
+
+/*!
+ * \brief scan_entry        One directory entry, path is only valid during the
+ *                          callback. Without stat only path, type and depth
+ *                          are set (unless the file system gives no d_type)
+ */
+struct scan_entry {
+  std::string_view path;
+  std::filesystem::file_type type{std::filesystem::file_type::unknown};
+  std::filesystem::perms permissions{std::filesystem::perms::unknown};
+  std::uintmax_t size{0};
+  std::int64_t mtime_ns{0}; // since the epoch
+  std::size_t depth{0};     // 0 for the contents of the root itself
+  bool has_stat{false};
+
+  [[nodiscard]] std::filesystem::file_status status() const {
+    return std::filesystem::file_status{type, permissions};
+  }
+};
+
+struct scan_options {
+  bool recursive{true};
+  bool stat{true};
+  std::size_t max_depth{std::numeric_limits<std::size_t>::max()};
+};
+
+struct scan_stats {
+  std::size_t entries{0};
+  std::size_t directories{0};
+  std::size_t errors{0}; // directories that could not be opened
+};
+
+namespace detail {
+
+inline std::filesystem::file_type file_type_of_mode(mode_t mode) noexcept {
+  using std::filesystem::file_type;
+  switch (mode & S_IFMT) {
+  case S_IFREG: return file_type::regular;
+  case S_IFDIR: return file_type::directory;
+  case S_IFLNK: return file_type::symlink;
+  case S_IFCHR: return file_type::character;
+  case S_IFBLK: return file_type::block;
+  case S_IFIFO: return file_type::fifo;
+  case S_IFSOCK: return file_type::socket;
+  default: return file_type::unknown;
+  }
+}
+
+inline std::filesystem::file_type file_type_of_dirent(unsigned char d_type) {
+  using std::filesystem::file_type;
+  switch (d_type) {
+  case DT_REG: return file_type::regular;
+  case DT_DIR: return file_type::directory;
+  case DT_LNK: return file_type::symlink;
+  case DT_CHR: return file_type::character;
+  case DT_BLK: return file_type::block;
+  case DT_FIFO: return file_type::fifo;
+  case DT_SOCK: return file_type::socket;
+  default: return file_type::none; // DT_UNKNOWN, needs a stat
+  }
+}
+
+struct scan_counters {
+  std::atomic<std::size_t> entries{0};
+  std::atomic<std::size_t> directories{0};
+  std::atomic<std::size_t> errors{0};
+
+  scan_stats get() const noexcept {
+    return {entries.load(), directories.load(), errors.load()};
+  }
+};
+
+// reads one directory and returns the subdirectories still to be scanned,
+// the directory is closed again before any of them is opened
+template <typename F>
+std::vector<std::string> scan_one(std::string dir, std::size_t depth,
+                                  scan_options const &options, F &f,
+                                  scan_counters &counters) {
+  auto subdirs = std::vector<std::string>{};
+  int const fd = ::open(dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  DIR *const stream = fd < 0 ? nullptr : ::fdopendir(fd);
+  if (!stream) {
+    if (fd >= 0)
+      ::close(fd);
+    counters.errors.fetch_add(1, std::memory_order_relaxed);
+    return subdirs;
+  }
+  counters.directories.fetch_add(1, std::memory_order_relaxed);
+  bool const descend = options.recursive && depth < options.max_depth;
+  if (dir.empty() || dir.back() != '/')
+    dir += '/';
+  auto const prefix = dir.size();
+  std::size_t entries{0};
+  while (auto const *const ent = ::readdir(stream)) {
+    if (!std::strcmp(ent->d_name, ".") || !std::strcmp(ent->d_name, ".."))
+      continue;
+    dir.resize(prefix);
+    dir += ent->d_name;
+    auto entry = scan_entry{};
+    entry.path = dir;
+    entry.depth = depth;
+    entry.type = file_type_of_dirent(ent->d_type);
+    struct stat st;
+    if ((options.stat || entry.type == std::filesystem::file_type::none) &&
+        ::fstatat(fd, ent->d_name, &st, AT_SYMLINK_NOFOLLOW) == 0) {
+      entry.type = file_type_of_mode(st.st_mode);
+      entry.permissions = static_cast<std::filesystem::perms>(st.st_mode) &
+                          std::filesystem::perms::mask;
+      entry.size = static_cast<std::uintmax_t>(st.st_size);
+      entry.mtime_ns = std::int64_t{st.st_mtim.tv_sec} * 1'000'000'000 +
+                       st.st_mtim.tv_nsec;
+      entry.has_stat = true;
+    }
+    ++entries;
+    f(std::as_const(entry));
+    if (descend && entry.type == std::filesystem::file_type::directory)
+      subdirs.push_back(dir);
+  }
+  ::closedir(stream);
+  counters.entries.fetch_add(entries, std::memory_order_relaxed);
+  return subdirs;
+}
+
+template <typename F>
+void scan_tree(task_group &group, std::string dir, std::size_t depth,
+               scan_options const &options, F &f, scan_counters &counters) {
+  for (auto &sub : scan_one(std::move(dir), depth, options, f, counters))
+    group.run([&group, sub = std::move(sub), depth, &options, &f, &counters] {
+      scan_tree(group, std::move(sub), depth + 1, options, f, counters);
+    });
+}
+
+} // namespace detail
+
+/*!
+ * \brief scan              Depth first traversal below root on the calling
+ *                          thread, root itself is not reported
+ * \param f                 Called as f(scan_entry const &) for every entry
+ */
+template <typename F>
+scan_stats scan(std::string root, scan_options const &options, F &&f) {
+  auto counters = detail::scan_counters{};
+  auto pending = std::vector<std::pair<std::string, std::size_t>>{};
+  pending.emplace_back(std::move(root), 0);
+  while (!pending.empty()) {
+    auto [dir, depth] = std::move(pending.back());
+    pending.pop_back();
+    for (auto &sub :
+         detail::scan_one(std::move(dir), depth, options, f, counters))
+      pending.emplace_back(std::move(sub), depth + 1);
+  }
+  return counters.get();
+}
+
+/*!
+ * \brief scan              Parallel traversal, every directory is read by a
+ *                          task of its own, so f is called concurrently from
+ *                          all workers in no particular order and must be
+ *                          thread safe and must not throw
+ * \param pool              Workers to run on, must not be the caller
+ */
+template <typename F>
+scan_stats scan(thread_pool &pool, std::string root,
+                scan_options const &options, F &&f) {
+  auto counters = detail::scan_counters{};
+  {
+    task_group group{pool};
+    group.run([&] {
+      detail::scan_tree(group, std::move(root), 0, options, f, counters);
+    });
+    group.wait();
+  }
+  return counters.get();
+}
+
+} // namespace Tesseract
@@ -1,4 +1,6 @@
-#include <experimental/filesystem>
+#include "captureIndex.hpp"
+#include "fileScanner.hpp"
+#include <filesystem>
 #include <iostream>
 #include <string>
 #include<iostream>
@@ -12,22 +14,16 @@
 #include <random>
 #include <algorithm>
 #include<thread>
+#include<mutex>
 #include<iterator>
 
 
 using namespace std;
-using namespace std::experimental::filesystem;
-//namespace fs = std::experimental::filesystem;
+using namespace std::filesystem;
+//namespace fs = std::filesystem;
 
 
 
-static auto file_info(const directory_entry &entry) {
-  auto const fs = status(entry);
-  return std::tuple(entry.path(),
-                    fs,
-                    is_regular_file(fs) ? file_size(entry.path()) : 0u);
-}
-
 static char type_char(file_status fs) {
   if (is_directory(fs)) { return 'd'; }
   else if (is_symlink(fs)) { return 'l'; }
@@ -87,18 +83,48 @@ int main(int argc, char *argv[]) {
 
 
 
-  auto items = vector<tuple<path, file_status, size_t>>{};
-  std::transform(directory_iterator{dir}, {},
-                 back_inserter(items),
-                 file_info);
-  for (auto const &[path, status, size] : items) {
-    cout << type_char(status)
-         << rwx(status.permissions()) << " "
-         << setw(4) << right << size_string(size)
-         << " " << path.filename().c_str()
-         << '\n';
+  // keeps .capture_index in dir, only new or modified captures are read
+  if (argc > 2 && string_view{argv[2]} == "-index") {
+    auto pool = Tesseract::thread_pool{};
+    auto index = Tesseract::capture_index{dir.string()};
+    index.load();
+    auto const stats = index.refresh(pool);
+    index.save();
+    cout << index.size() << " files indexed, " << stats.updated
+         << " updated, " << stats.unchanged << " unchanged, " << stats.removed
+         << " removed\n";
+    return 0;
   }
 
+  // one fstatat per entry instead of status() plus file_size(), and with -r
+  // the whole tree is scanned in parallel and printed as it is read. Like
+  // status(), symlinks are listed as their target, and only regular files
+  // have a size
+  auto const recursive = argc > 2 && string_view{argv[2]} == "-r";
+  auto pool = Tesseract::thread_pool{};
+  auto out = mutex{};
+  auto const stats = Tesseract::scan(
+      pool, dir.string(), {recursive}, [&](Tesseract::scan_entry const &e) {
+        auto const p = path{e.path};
+        auto const name = recursive ? p.native() : p.filename().native();
+        auto fs = e.status();
+        auto size = e.size;
+        if (is_symlink(fs)) { // the scanner does not follow links
+          auto ec = error_code{};
+          fs = status(p, ec);
+          size = is_regular_file(fs) ? file_size(p, ec) : 0u;
+        }
+        if (!is_regular_file(fs))
+          size = 0;
+        auto line = stringstream{};
+        line << type_char(fs) << rwx(fs.permissions()) << " " << setw(4)
+             << right << size_string(size) << " " << name << '\n';
+        auto const lock = lock_guard{out};
+        cout << line.rdbuf();
+      });
+  cout << stats.entries << " entries in " << stats.directories
+       << " directories\n";
+
 
   cout << thread::hardware_concurrency()
        << " concurrent threads are supported.\n";
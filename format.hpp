@@ -0,0 +1,174 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <charconv>
+#include <cstddef>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <type_traits>
+
+namespace Tesseract {
+
+/*
+Formatting through std::to_chars: no locale, no stream state, no allocation.
+A format_sink collects everything in a fixed buffer and hands it to the
+destination stream with one write per full buffer (or per explicit flush),
+instead of one formatted insertion, sentry and virtual call per value.
+*/
+
+template <typename T>
+inline constexpr bool is_chars_formattable_v =
+    std::is_arithmetic_v<std::decay_t<T>> ||
+    std::is_convertible_v<T const &, std::string_view>;
+
+namespace detail {
+
+// enough for any integer and any double in general or scientific notation
+inline constexpr std::size_t max_number_chars = 64;
+// the precision of a default constructed std::ostream
+inline constexpr int default_precision = 6;
+// digits that fit next to sign, point and an exponent like e-4951, higher
+// precisions only add digits of the exact binary value anyway
+inline constexpr int max_precision = static_cast<int>(max_number_chars) - 8;
+
+// streamed as a character, not as a number, std::uint8_t and std::int8_t
+// included
+template <typename T>
+inline constexpr bool is_character_v =
+    std::is_same_v<T, char> || std::is_same_v<T, signed char> ||
+    std::is_same_v<T, unsigned char>;
+
+template <typename T>
+char *to_chars(char *first, char *last, T value, int precision) {
+  std::to_chars_result result;
+  if constexpr (std::is_same_v<T, bool>) {
+    *first = value ? '1' : '0'; // same as operator<< without boolalpha
+    return first + 1;
+  } else if constexpr (is_character_v<T>) {
+    *first = static_cast<char>(value);
+    return first + 1;
+  } else if constexpr (std::is_floating_point_v<T>) {
+    result = precision < 0 ? std::to_chars(first, last, value)
+                           : std::to_chars(first, last, value,
+                                           std::chars_format::general,
+                                           std::min(precision, max_precision));
+  } else {
+    result = std::to_chars(first, last, value);
+  }
+  assert(result.ec == std::errc{});
+  return result.ptr;
+}
+
+} // namespace detail
+
+/*!
+ * \brief basic_format_sink         Buffered, locale-free output of numbers and
+ *                                  strings with the variadic interface of
+ *                                  to_string, i.e. sink(a, ' ', b, '\n')
+ * \param out                       Destination, written to whenever the
+ *                                  buffer is full, on flush() and on
+ *                                  destruction
+ */
+template <std::size_t Capacity = 1 << 16> class basic_format_sink {
+  static_assert(Capacity >= detail::max_number_chars);
+
+public:
+  explicit basic_format_sink(std::ostream &out) : out_{out} {}
+  basic_format_sink(basic_format_sink const &) = delete;
+  basic_format_sink &operator=(basic_format_sink const &) = delete;
+  ~basic_format_sink() { flush(); }
+
+  // significant digits of floating point values like std::setprecision in
+  // general notation, a negative value selects the shortest representation
+  // that reads back to the same value, more than detail::max_precision
+  // digits are cut to that
+  basic_format_sink &precision(int digits) noexcept {
+    precision_ = digits;
+    return *this;
+  }
+
+  template <typename... Ts> basic_format_sink &operator()(Ts const &... ts) {
+    static_assert((is_chars_formattable_v<Ts> && ...),
+                  "only numbers and strings are supported");
+    (put(ts), ...);
+    return *this;
+  }
+
+  void flush() {
+    if (size_) {
+      out_.write(buffer_.data(), static_cast<std::streamsize>(size_));
+      size_ = 0;
+    }
+    out_.flush();
+  }
+
+  [[nodiscard]] std::string_view view() const noexcept {
+    return {buffer_.data(), size_};
+  }
+
+private:
+  void drain() {
+    out_.write(buffer_.data(), static_cast<std::streamsize>(size_));
+    size_ = 0;
+  }
+
+  template <typename T> void put(T const &value) {
+    if constexpr (std::is_arithmetic_v<T>) {
+      if (Capacity - size_ < detail::max_number_chars)
+        drain();
+      auto *const first = buffer_.data() + size_;
+      size_ = static_cast<std::size_t>(
+          detail::to_chars(first, buffer_.data() + Capacity, value,
+                           precision_) -
+          buffer_.data());
+    } else {
+      auto const s = std::string_view{value};
+      if (Capacity - size_ < s.size()) {
+        drain();
+        if (s.size() > Capacity) { // bigger than the whole buffer
+          out_.write(s.data(), static_cast<std::streamsize>(s.size()));
+          return;
+        }
+      }
+      s.copy(buffer_.data() + size_, s.size());
+      size_ += s.size();
+    }
+  }
+
+  std::ostream &out_;
+  std::size_t size_{0};
+  int precision_{detail::default_precision};
+  std::array<char, Capacity> buffer_;
+};
+
+using format_sink = basic_format_sink<>;
+
+/*!
+ * \brief format_to                 Appends numbers and strings to s just like
+ *                                  a default constructed std::ostream, the
+ *                                  only allocation is the growth of s itself
+ */
+template <typename... Ts>
+std::string &format_to(std::string &s, Ts const &... ts) {
+  static_assert((is_chars_formattable_v<Ts> && ...),
+                "only numbers and strings are supported");
+  auto const put = [&s](auto const &value) {
+    using T = std::decay_t<decltype(value)>;
+    if constexpr (std::is_arithmetic_v<T>) {
+      std::array<char, detail::max_number_chars> chars;
+      auto *const last = detail::to_chars(
+          chars.data(), chars.data() + chars.size(), value,
+          detail::default_precision);
+      s.append(chars.data(), last);
+    } else {
+      s.append(std::string_view{value});
+    }
+  };
+  (put(ts), ...);
+  return s;
+}
+
+} // namespace Tesseract
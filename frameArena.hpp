@@ -0,0 +1,135 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdlib>
+#include <memory>
+#include <memory_resource>
+#include <new>
+#include <optional>
+
+namespace Tesseract {
+
+/*
+Per frame memory. Containers of a frame are std::pmr containers that take
+their storage from a frame_arena, i.e. allocating is a pointer bump,
+deallocating is a no-op and reset() drops everything at once. If a frame
+needs more than the arena holds, the excess comes from the upstream resource
+for that frame and the arena grows at the next reset, so that in steady state
+no frame touches the heap at all. TESSERACT_COUNT_ALLOCATIONS turns that into
+something a demo or test can check.
+*/
+
+/*!
+ * \brief counting_resource Forwards to another memory resource and counts
+ *                          what passes through
+ */
+class counting_resource : public std::pmr::memory_resource {
+public:
+  explicit counting_resource(
+      std::pmr::memory_resource *upstream = std::pmr::get_default_resource())
+      : upstream_{upstream} {}
+
+  [[nodiscard]] std::size_t allocations() const noexcept {
+    return allocations_;
+  }
+  [[nodiscard]] std::size_t bytes() const noexcept { return bytes_; }
+  void clear() noexcept { allocations_ = bytes_ = 0; }
+
+private:
+  void *do_allocate(std::size_t bytes, std::size_t alignment) override {
+    ++allocations_;
+    bytes_ += bytes;
+    return upstream_->allocate(bytes, alignment);
+  }
+  void do_deallocate(void *p, std::size_t bytes,
+                     std::size_t alignment) override {
+    upstream_->deallocate(p, bytes, alignment);
+  }
+  bool do_is_equal(
+      std::pmr::memory_resource const &other) const noexcept override {
+    return this == &other;
+  }
+
+  std::pmr::memory_resource *upstream_;
+  std::size_t allocations_{0};
+  std::size_t bytes_{0};
+};
+
+/*!
+ * \brief frame_arena       Monotonic arena that is reset once per frame and
+ *                          grows to the largest frame seen so far. Not thread
+ *                          safe, use one arena per thread
+ * \param initial_bytes     Size of the first buffer
+ * \param upstream          Where the buffer and any overflow come from
+ */
+class frame_arena {
+public:
+  explicit frame_arena(
+      std::size_t initial_bytes = std::size_t{1} << 20,
+      std::pmr::memory_resource *upstream = std::pmr::get_default_resource())
+      : upstream_{upstream} {
+    allocate_buffer(initial_bytes);
+  }
+  frame_arena(frame_arena const &) = delete;
+  frame_arena &operator=(frame_arena const &) = delete;
+  ~frame_arena() {
+    arena_.reset();
+    upstream_.deallocate(buffer_, capacity_, alignof(std::max_align_t));
+  }
+
+  [[nodiscard]] std::pmr::memory_resource *resource() noexcept {
+    return &*arena_;
+  }
+  template <typename T = std::byte>
+  [[nodiscard]] std::pmr::polymorphic_allocator<T> allocator() noexcept {
+    return resource();
+  }
+
+  [[nodiscard]] std::size_t capacity() const noexcept { return capacity_; }
+  // frames since construction that did not fit into the buffer
+  [[nodiscard]] std::size_t overflows() const noexcept { return overflows_; }
+
+  // everything allocated from the arena must be gone by now
+  void reset() {
+    arena_->release();
+    if (upstream_.allocations() <= 1) // only the buffer itself
+      return;
+    ++overflows_;
+    auto const needed = upstream_.bytes(); // the buffer and the overflow
+    arena_.reset();
+    upstream_.deallocate(buffer_, capacity_, alignof(std::max_align_t));
+    allocate_buffer(needed + needed / 2);
+  }
+
+private:
+  void allocate_buffer(std::size_t bytes) {
+    upstream_.clear();
+    capacity_ = bytes;
+    buffer_ = upstream_.allocate(capacity_, alignof(std::max_align_t));
+    arena_.emplace(buffer_, capacity_, &upstream_);
+  }
+
+  counting_resource upstream_;
+  void *buffer_{nullptr};
+  std::size_t capacity_{0};
+  std::size_t overflows_{0};
+  std::optional<std::pmr::monotonic_buffer_resource> arena_;
+};
+
+// number of calls of the global operator new so far, only counted in
+// programs that use TESSERACT_COUNT_ALLOCATIONS
+inline std::atomic<std::size_t> heap_allocations{0};
+
+} // namespace Tesseract
+
+// replaces the global operator new/delete with counting versions, to be used
+// once at namespace scope in the translation unit that holds main()
+#define TESSERACT_COUNT_ALLOCATIONS                                            \
+  void *operator new(std::size_t n) {                                          \
+    Tesseract::heap_allocations.fetch_add(1, std::memory_order_relaxed);      \
+    if (auto *const p = std::malloc(n ? n : 1))                                \
+      return p;                                                                \
+    throw std::bad_alloc{};                                                    \
+  }                                                                            \
+  void operator delete(void *p) noexcept { std::free(p); }                     \
+  void operator delete(void *p, std::size_t) noexcept { std::free(p); }
@@ -0,0 +1,277 @@
+#pragma once
+#include "threadPool.hpp"
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <functional>
+#include <iterator>
+#include <optional>
+#include <ranges>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace funclib {
+
+/*
+Lazy counterparts of the eager mapf/foldl in HigherOrderFunctions_MapAndFold.
+mapf and filterf return views instead of copies, nothing is computed until a
+fold pulls the elements through, hence
+
+  foldl(std::plus<>(), mapf(sq, mapf(abs, v)), 0)
+
+is one pass over v without a single allocation. Containers passed as lvalues
+are referenced, rvalues are moved into the view.
+*/
+
+/*!
+ * \brief mapf              Lazily applies f to every element of r
+ */
+template <typename F, std::ranges::viewable_range R>
+constexpr auto mapf(F &&f, R &&r) {
+  return std::views::transform(std::forward<R>(r), std::forward<F>(f));
+}
+
+/*!
+ * \brief filterf           Lazily skips every element of r that does not
+ *                          satisfy the predicate p
+ */
+template <typename P, std::ranges::viewable_range R>
+constexpr auto filterf(P &&p, R &&r) {
+  return std::views::filter(std::forward<R>(r), std::forward<P>(p));
+}
+
+template <typename F, std::ranges::input_range R, typename T>
+constexpr T foldl(F &&f, R &&r, T i) {
+  for (auto &&x : r)
+    i = std::invoke(f, std::move(i), std::forward<decltype(x)>(x));
+  return i;
+}
+
+template <typename F, std::ranges::bidirectional_range R, typename T>
+constexpr T foldr(F &&f, R &&r, T i) {
+  return foldl(std::forward<F>(f), std::views::reverse(r), std::move(i));
+}
+
+/*
+Folds that may reorder their operands. The caller declares what the operation
+allows, either through the traits below or by wrapping it in associative() or
+commutative(). The standard arithmetic and bitwise function objects count as
+commutative monoids, for floating point types this accepts the same rounding
+differences std::reduce does.
+
+  associative   contiguous blocks are folded in lockstep, i.e. several
+                independent dependency chains instead of one
+  commutative   interleaved accumulators that the compiler keeps in SIMD
+                registers, combined as a tree
+  kahan_plus    compensated summation, sequential but with an error bound
+                independent of n (breaks under -ffast-math)
+  pairwise_plus recursive halving, O(log n) error growth at full speed
+*/
+// commutative here always means commutative and associative, the interleaved
+// order relies on both, so commutative(f) implies associative(f)
+struct associative_tag {};
+struct commutative_tag : associative_tag {};
+
+template <typename F, typename Tag> struct declared_op : Tag {
+  F f_;
+  template <typename A, typename B>
+  constexpr decltype(auto) operator()(A &&a, B &&b) const {
+    return std::invoke(f_, std::forward<A>(a), std::forward<B>(b));
+  }
+};
+
+template <typename F> constexpr auto associative(F f) {
+  return declared_op<F, associative_tag>{{}, std::move(f)};
+}
+template <typename F> constexpr auto commutative(F f) {
+  return declared_op<F, commutative_tag>{{}, std::move(f)};
+}
+
+struct kahan_plus : commutative_tag {
+  template <typename T> constexpr T operator()(T const &a, T const &b) const {
+    return a + b;
+  }
+};
+struct pairwise_plus : commutative_tag {
+  template <typename T> constexpr T operator()(T const &a, T const &b) const {
+    return a + b;
+  }
+};
+
+template <typename F>
+struct is_commutative : std::is_base_of<commutative_tag, F> {};
+template <typename T> struct is_commutative<std::plus<T>> : std::true_type {};
+template <typename T>
+struct is_commutative<std::multiplies<T>> : std::true_type {};
+template <typename T>
+struct is_commutative<std::bit_and<T>> : std::true_type {};
+template <typename T>
+struct is_commutative<std::bit_or<T>> : std::true_type {};
+template <typename T>
+struct is_commutative<std::bit_xor<T>> : std::true_type {};
+template <typename T>
+struct is_commutative<std::logical_and<T>> : std::true_type {};
+template <typename T>
+struct is_commutative<std::logical_or<T>> : std::true_type {};
+
+template <typename F>
+struct is_associative
+    : std::bool_constant<std::is_base_of_v<associative_tag, F> ||
+                         is_commutative<F>::value> {};
+
+template <typename F>
+inline constexpr bool is_commutative_v =
+    is_commutative<std::decay_t<F>>::value;
+template <typename F>
+inline constexpr bool is_associative_v =
+    is_associative<std::decay_t<F>>::value;
+
+namespace detail {
+
+inline constexpr std::size_t lanes = 8;
+inline constexpr std::size_t pairwise_block = 128;
+
+template <typename F, typename It, typename T>
+T fold_n(F &f, It first, std::size_t n, T i) {
+  for (std::size_t k = 0; k < n; ++k)
+    i = std::invoke(f, std::move(i), first[k]);
+  return i;
+}
+
+// accumulator k sees the elements k, k + lanes, k + 2 * lanes, ...
+template <typename F, typename It, typename T>
+T fold_interleaved(F &f, It first, std::size_t n, T i) {
+  if (n < 2 * lanes)
+    return fold_n(f, first, n, std::move(i));
+  std::array<T, lanes> acc;
+  for (std::size_t k = 0; k < lanes; ++k)
+    acc[k] = static_cast<T>(first[k]);
+  auto j = lanes;
+  for (; j + lanes <= n; j += lanes)
+    for (std::size_t k = 0; k < lanes; ++k)
+      acc[k] = std::invoke(f, acc[k], first[j + k]);
+  for (std::size_t k = 0; k < n - j; ++k) // less than lanes left
+    acc[k] = std::invoke(f, acc[k], first[j + k]);
+  for (auto width = lanes / 2; width > 0; width /= 2)
+    for (std::size_t k = 0; k < width; ++k)
+      acc[k] = std::invoke(f, acc[k], acc[k + width]);
+  return std::invoke(f, std::move(i), acc[0]);
+}
+
+// accumulator k folds the k-th contiguous block, combined in block order
+template <typename F, typename It, typename T>
+T fold_blocked(F &f, It first, std::size_t n, T i) {
+  if (n < 2 * lanes)
+    return fold_n(f, first, n, std::move(i));
+  auto const block = n / lanes;
+  std::vector<T> acc;
+  acc.reserve(lanes);
+  for (std::size_t k = 0; k < lanes; ++k)
+    acc.push_back(static_cast<T>(first[k * block]));
+  for (std::size_t j = 1; j < block; ++j)
+    for (std::size_t k = 0; k < lanes; ++k)
+      acc[k] = std::invoke(f, std::move(acc[k]), first[k * block + j]);
+  // the remainder directly follows the last block
+  for (auto j = lanes * block; j < n; ++j)
+    acc.back() = std::invoke(f, std::move(acc.back()), first[j]);
+  for (auto &a : acc)
+    i = std::invoke(f, std::move(i), std::move(a));
+  return i;
+}
+
+template <typename It, typename T>
+T kahan_sum(It first, std::size_t n, T i) {
+  T compensation{};
+  for (std::size_t k = 0; k < n; ++k) {
+    T const y = static_cast<T>(first[k]) - compensation;
+    T const t = i + y;
+    compensation = (t - i) - y;
+    i = t;
+  }
+  return i;
+}
+
+template <typename It, typename T> T pairwise_sum(It first, std::size_t n) {
+  if (n <= pairwise_block) {
+    auto plus = std::plus<T>{};
+    return fold_interleaved(plus, first, n, T{});
+  }
+  auto const half = n / 2;
+  return pairwise_sum<It, T>(first, half) +
+         pairwise_sum<It, T>(first + half, n - half);
+}
+
+} // namespace detail
+
+/*!
+ * \brief fold              Sequential fold that picks the fastest evaluation
+ *                          order f allows, see above. Falls back to foldl for
+ *                          plain operations and non random access ranges
+ */
+template <typename F, std::ranges::input_range R, typename T>
+T fold(F &&f, R &&r, T i) {
+  using op_t = std::decay_t<F>;
+  if constexpr (std::ranges::random_access_range<R> &&
+                std::ranges::sized_range<R>) {
+    auto const first = std::ranges::begin(r);
+    auto const n = static_cast<std::size_t>(std::ranges::size(r));
+    if constexpr (std::is_same_v<op_t, kahan_plus>)
+      return detail::kahan_sum(first, n, std::move(i));
+    else if constexpr (std::is_same_v<op_t, pairwise_plus>)
+      return std::move(i) +
+             detail::pairwise_sum<decltype(first), T>(first, n);
+    else if constexpr (is_commutative_v<F> &&
+                       std::is_default_constructible_v<T>)
+      return detail::fold_interleaved(f, first, n, std::move(i));
+    else if constexpr (is_associative_v<F>)
+      return detail::fold_blocked(f, first, n, std::move(i));
+  }
+  return foldl(std::forward<F>(f), std::forward<R>(r), std::move(i));
+}
+
+/*!
+ * \brief fold              Parallel fold with the semantics of std::reduce
+ *                          for operations declared associative, as the
+ *                          elements are grouped arbitrarily. Chunks of a
+ *                          random access range are folded on the pool, their
+ *                          results are combined in order, so f need not be
+ *                          commutative. Other operations and ranges are
+ *                          folded sequentially by foldl. Each chunk is folded
+ *                          by the sequential fold() above
+ * \param pool              Workers to run on, must not be the caller
+ * \param f                 Binary operation on T
+ * \param r                 Range whose elements are convertible to T
+ * \param i                 Initial value, applied exactly once
+ */
+template <typename F, std::ranges::input_range R, typename T>
+T fold(Tesseract::thread_pool &pool, F &&f, R &&r, T i) {
+  if constexpr (is_associative_v<F> && std::ranges::random_access_range<R> &&
+                std::ranges::sized_range<R>) {
+    constexpr std::ptrdiff_t grain = 1 << 14;
+    auto const n = static_cast<std::ptrdiff_t>(std::ranges::size(r));
+    auto const chunks = std::min<std::ptrdiff_t>(pool.size(), n / grain);
+    if (chunks > 1) {
+      auto partial = std::vector<std::optional<T>>(chunks);
+      {
+        Tesseract::task_group group{pool};
+        for (std::ptrdiff_t c = 0; c < chunks; ++c)
+          group.run([&, c] {
+            auto const first = std::ranges::begin(r) + n * c / chunks;
+            auto const last = std::ranges::begin(r) + n * (c + 1) / chunks;
+            partial[c] = fold(f, std::ranges::subrange(first + 1, last),
+                              static_cast<T>(*first));
+          });
+        group.wait();
+      }
+      auto values = std::vector<T>{};
+      values.reserve(partial.size());
+      for (auto &p : partial)
+        values.push_back(std::move(*p));
+      return fold(f, values, std::move(i));
+    }
+  }
+  return foldl(std::forward<F>(f), std::forward<R>(r), std::move(i));
+}
+
+} // namespace funclib
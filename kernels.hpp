@@ -0,0 +1,157 @@
+#pragma once
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <utility>
+
+namespace Tesseract {
+
+/*
+Whole array counterparts of scaleValue and clampValue. The range is turned
+into one multiply-add with a precomputed factor instead of a division per
+value, and clamping uses plain selects that map onto min/max instructions, so
+every loop below is a straight SIMD pass the compiler vectorizes at -O3.
+to_u8 fuses scale, clamp and quantization, i.e. a power grid becomes a display
+image in a single read and a single write. Input and output may be the same
+array, otherwise they must not overlap. NaNs end up at the lower bound.
+*/
+
+/*!
+ * \brief linear_map        Precomputed x -> (x - min) / (max - min) * new_max
+ */
+struct linear_map {
+  float scale;
+  float offset;
+
+  constexpr linear_map(float min, float max, float new_max = 1)
+      : scale{new_max / (max - min)}, offset{-min * (new_max / (max - min))} {
+    assert(max != min); // prevent division by zero
+  }
+
+  constexpr float operator()(float x) const noexcept {
+    return x * scale + offset;
+  }
+};
+
+namespace detail {
+
+// unlike std::clamp no branches and NaN goes to lo, compiles to maxps/minps
+constexpr float clamp_select(float x, float lo, float hi) noexcept {
+  x = x > lo ? x : lo;
+  return x < hi ? x : hi;
+}
+
+} // namespace detail
+
+/*!
+ * \brief minmax            Smallest and largest value in one pass, with
+ *                          independent lanes so that it vectorizes (fewer
+ *                          lanes get unrolled into scalar code instead)
+ * \param in                Must not be empty
+ */
+inline std::pair<float, float> minmax(std::span<float const> in) noexcept {
+  assert(!in.empty());
+  constexpr std::size_t lanes = 32;
+  float lo[lanes], hi[lanes];
+  for (std::size_t k = 0; k < lanes; ++k)
+    lo[k] = hi[k] = in[0];
+  auto const n = in.size();
+  auto i = std::size_t{0};
+  for (; i + lanes <= n; i += lanes)
+    for (std::size_t k = 0; k < lanes; ++k) {
+      lo[k] = in[i + k] < lo[k] ? in[i + k] : lo[k];
+      hi[k] = hi[k] < in[i + k] ? in[i + k] : hi[k];
+    }
+  for (; i < n; ++i) {
+    lo[0] = in[i] < lo[0] ? in[i] : lo[0];
+    hi[0] = hi[0] < in[i] ? in[i] : hi[0];
+  }
+  for (std::size_t k = 1; k < lanes; ++k) {
+    lo[0] = lo[k] < lo[0] ? lo[k] : lo[0];
+    hi[0] = hi[0] < hi[k] ? hi[k] : hi[0];
+  }
+  return {lo[0], hi[0]};
+}
+
+/*!
+ * \brief scale             Array version of scaleValue
+ * \param in                Source values
+ * \param out               Destination, at least as large as in
+ * \param min               Value mapped onto 0
+ * \param max               Value mapped onto new_max
+ */
+inline void scale(std::span<float const> in, std::span<float> out, float min,
+                  float max, float new_max = 1) noexcept {
+  assert(out.size() >= in.size());
+  auto const f = linear_map{min, max, new_max};
+  auto const *const src = in.data();
+  auto *const dst = out.data();
+  for (std::size_t i = 0, n = in.size(); i < n; ++i)
+    dst[i] = f(src[i]);
+}
+
+/*!
+ * \brief clamp             Array version of clampValue
+ */
+inline void clamp(std::span<float const> in, std::span<float> out, float min,
+                  float max) noexcept {
+  assert(out.size() >= in.size());
+  auto const *const src = in.data();
+  auto *const dst = out.data();
+  for (std::size_t i = 0, n = in.size(); i < n; ++i)
+    dst[i] = detail::clamp_select(src[i], min, max);
+}
+
+/*!
+ * \brief normalize         Maps [min, max] of the input onto [0, 1], values
+ *                          outside are clamped
+ */
+inline void normalize(std::span<float const> in, std::span<float> out,
+                      float min, float max) noexcept {
+  assert(out.size() >= in.size());
+  auto const f = linear_map{min, max};
+  auto const *const src = in.data();
+  auto *const dst = out.data();
+  for (std::size_t i = 0, n = in.size(); i < n; ++i)
+    dst[i] = detail::clamp_select(f(src[i]), 0.F, 1.F);
+}
+
+/*!
+ * \brief normalize         Same as above for the range of the data itself,
+ *                          constant data is mapped onto 0
+ */
+inline void normalize(std::span<float const> in,
+                      std::span<float> out) noexcept {
+  if (in.empty())
+    return;
+  auto const [min, max] = minmax(in);
+  if (min == max) {
+    for (std::size_t i = 0, n = in.size(); i < n; ++i)
+      out[i] = 0.F;
+    return;
+  }
+  normalize(in, out, min, max);
+}
+
+/*!
+ * \brief to_u8             Fused scale, clamp and quantize: min maps onto 0,
+ *                          max onto 255, rounded to the nearest level
+ * \param in                Source values, e.g. a power grid in dB
+ * \param out               8 bit image, at least as large as in
+ */
+inline void to_u8(std::span<float const> in, std::span<std::uint8_t> out,
+                  float min, float max) noexcept {
+  assert(out.size() >= in.size());
+  auto f = linear_map{min, max, 255.F};
+  // truncating x + 0.5 rounds non-negative values, the 0.5 goes into the
+  // offset since any arithmetic after the selects keeps GCC from if-converting
+  f.offset += .5F;
+  auto const *const src = in.data();
+  auto *const dst = out.data();
+  for (std::size_t i = 0, n = in.size(); i < n; ++i)
+    dst[i] = static_cast<std::uint8_t>(
+        static_cast<int>(detail::clamp_select(f(src[i]), 0.F, 255.5F)));
+}
+
+} // namespace Tesseract
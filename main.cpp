@@ -1,4 +1,11 @@
+#include <algorithm>
+#include <cmath>
+#include <complex>
 #include <iostream>
+#include <utility>
+#include <vector>
+#include "clustering.hpp"
+#include "pipeline.hpp"
 #include "radar.hpp"
 #include "radarPolicies.hpp"
 
@@ -13,15 +20,94 @@ void invoke(CuriousBase<T> const &c) { c.foo(); }
 template<typename T>
 using myGrid = Grid<T>;
 
+// one frame of the pipeline demo: a target at angle degrees seen by the
+// channels, the beams and the strongest of them
+struct Frame {
+  int index{0};
+  double angle{0};
+  std::size_t channels{8};
+  std::vector<std::complex<float>> maps;
+  std::vector<std::complex<float>> beams;
+  std::size_t strongest{0};
+};
+
+template<typename _Radar>
+struct Acquisition {
+  void stage(Frame &frame) const {
+    auto const &radar = static_cast<_Radar const &>(*this);
+    auto const cells = static_cast<std::size_t>(radar.numberOfRangeCells);
+    auto const sine = std::sin(frame.angle * M_PI / 180.0);
+    frame.maps.resize(frame.channels * cells);
+    for (std::size_t c = 0; c < frame.channels; ++c)
+      std::fill_n(frame.maps.begin() + c * cells, cells,
+                  std::polar(1.F, static_cast<float>(M_PI * c * sine)));
+    frame.beams.resize(radar.numberOfAngularBeams * cells);
+  }
+};
+
+template<typename _Radar>
+struct Detection {
+  void stage(Frame &frame) const {
+    auto const cells = frame.maps.size() / frame.channels;
+    for (std::size_t b = 0; b < frame.beams.size() / cells; ++b)
+      if (std::abs(frame.beams[b * cells]) >
+          std::abs(frame.beams[frame.strongest * cells]))
+        frame.strongest = b;
+    std::cout << "frame " << frame.index << ": target at " << frame.angle
+              << " degrees in beam " << frame.strongest << '\n';
+  }
+};
+
 int main() {
   // invoke(_ars300);
-  using ARS300Model = Radar<ARS300, ObjectCounter, Diagnosis_t, myGrid >;
+  using ARS300Model =
+      Radar<ARS300, ObjectCounter, Diagnosis_t, myGrid, Acquisition,
+            Beamforming, Detection>;
   auto ars300Model = ARS300Model{Layout::PolarGrid};
   if (rt::isAutomotiveRadar<rt::ARS300>)
     std::cout << ars300Model << std::endl;
-}
-
-
 
+  // one target 20 degrees off boresight, seen by 8 antennas at half a
+  // wavelength in every cell of a small range-Doppler map
+  auto const channels = std::size_t{8}, cells = std::size_t{64};
+  auto const sine = std::sin(20.0 * M_PI / 180.0);
+  auto maps = std::vector<std::complex<float>>(channels * cells);
+  for (std::size_t c = 0; c < channels; ++c)
+    std::fill_n(maps.begin() + c * cells, cells,
+                std::polar(1.F, static_cast<float>(M_PI * c * sine)));
+  auto beams = std::vector<std::complex<float>>(
+      ars300Model.numberOfAngularBeams * cells);
+  ars300Model.beamform(maps, channels, beams);
+  auto strongest = std::size_t{0};
+  for (std::size_t b = 0; b < beams.size() / cells; ++b)
+    if (std::abs(beams[b * cells]) > std::abs(beams[strongest * cells]))
+      strongest = b;
+  std::cout << "strongest beam " << strongest << " at "
+            << std::asin(ars300Model.beamformer()->sine(strongest)) * 180 /
+                   M_PI
+            << " degrees\n";
 
+  // two groups of detections in range and azimuth and one stray detection
+  auto const ranges = std::vector<float>{50.0F, 50.4F, 50.9F, 120.F, 120.6F,
+                                         121.0F, 121.3F, 180.F};
+  auto const azimuths = std::vector<float>{0.10F, 0.11F, 0.09F, -0.30F,
+                                           -0.31F, -0.29F, -0.30F, 0.5F};
+  auto clusterer = Tesseract::dbscan::for_sensor(ars300Model, 3);
+  for (auto const &c : clusterer({ranges, azimuths}).clusters)
+    std::cout << "cluster of " << c.size << " at "
+              << static_cast<long double>(c.range) << " m, "
+              << static_cast<long double>(c.range_extent) << " m deep\n";
 
+  // acquisition, beamforming and detection of successive frames overlap,
+  // with at most 3 frames in flight
+  auto pool = Tesseract::thread_pool{};
+  auto pipeline = Tesseract::frame_pipeline<ARS300Model, Frame>{ars300Model,
+                                                                pool, 3};
+  for (auto i = 0; i < 6; ++i) {
+    auto frame = Frame{};
+    frame.index = i;
+    frame.angle = -25.0 + 10 * i;
+    pipeline.push(std::move(frame));
+  }
+  pipeline.wait();
+}
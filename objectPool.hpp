@@ -0,0 +1,209 @@
+#pragma once
+#include <cassert>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace Tesseract {
+
+/*
+Per type object pools for things that are created and dropped at sensor rate.
+Storage is allocated in blocks and never given back before the pool dies, a
+released object is destroyed in place and its slot goes onto a LIFO free list,
+so in steady state acquire() is a pop plus the constructor and release a
+destructor plus a push. Handles are move-only, hence there is no reference
+count at all, and a single threaded pool does not lock either.
+*/
+
+enum class pool_threading {
+  single_threaded, // no locking, the pool and its handles stay on one thread
+  shared           // acquire and release may happen on any thread
+};
+
+struct pool_stats {
+  std::size_t hits{0};   // recycled or reserved slot
+  std::size_t misses{0}; // fresh slot, possibly a new block
+  std::size_t in_use{0};
+  std::size_t capacity{0};
+};
+
+namespace detail {
+
+struct null_mutex {
+  void lock() noexcept {}
+  void unlock() noexcept {}
+};
+
+struct recycler {
+  virtual void recycle(void *object) noexcept = 0;
+
+protected:
+  ~recycler() = default;
+};
+
+} // namespace detail
+
+/*!
+ * \brief pool_ptr          Unique owner of a pooled object, gives it back to
+ *                          its pool on destruction. Converts to pool_ptr of
+ *                          a base class like std::unique_ptr, the object is
+ *                          still destroyed as its dynamic type
+ */
+template <typename T> class pool_ptr {
+public:
+  pool_ptr() noexcept = default;
+  pool_ptr(pool_ptr &&other) noexcept
+      : ptr_{std::exchange(other.ptr_, nullptr)},
+        object_{std::exchange(other.object_, nullptr)},
+        pool_{std::exchange(other.pool_, nullptr)} {}
+
+  template <typename U, typename = std::enable_if_t<
+                            std::is_convertible_v<U *, T *>>>
+  pool_ptr(pool_ptr<U> &&other) noexcept
+      : ptr_{std::exchange(other.ptr_, nullptr)},
+        object_{std::exchange(other.object_, nullptr)},
+        pool_{std::exchange(other.pool_, nullptr)} {}
+
+  pool_ptr &operator=(pool_ptr &&other) noexcept {
+    pool_ptr{std::move(other)}.swap(*this);
+    return *this;
+  }
+
+  ~pool_ptr() { reset(); }
+
+  void reset() noexcept {
+    if (pool_)
+      std::exchange(pool_, nullptr)->recycle(object_);
+    ptr_ = nullptr;
+    object_ = nullptr;
+  }
+
+  void swap(pool_ptr &other) noexcept {
+    std::swap(ptr_, other.ptr_);
+    std::swap(object_, other.object_);
+    std::swap(pool_, other.pool_);
+  }
+
+  [[nodiscard]] T *get() const noexcept { return ptr_; }
+  T &operator*() const noexcept { return *ptr_; }
+  T *operator->() const noexcept { return ptr_; }
+  explicit operator bool() const noexcept { return ptr_ != nullptr; }
+
+private:
+  template <typename> friend class pool_ptr;
+  template <typename, pool_threading, std::size_t> friend class object_pool;
+
+  pool_ptr(T *ptr, detail::recycler *pool) noexcept
+      : ptr_{ptr}, object_{ptr}, pool_{pool} {}
+
+  T *ptr_{nullptr};
+  void *object_{nullptr}; // the pooled type, for the pool
+  detail::recycler *pool_{nullptr};
+};
+
+/*!
+ * \brief object_pool       Recycles the storage of T, must outlive all of its
+ *                          handles
+ * \tparam Threading        Whether acquire and release need a lock
+ * \tparam BlockSize        Objects per block allocation
+ */
+template <typename T,
+          pool_threading Threading = pool_threading::single_threaded,
+          std::size_t BlockSize = 64>
+class object_pool final : detail::recycler {
+  static_assert(BlockSize > 0);
+
+public:
+  object_pool() = default;
+  explicit object_pool(std::size_t initial_capacity) {
+    reserve(initial_capacity);
+  }
+  object_pool(object_pool const &) = delete;
+  object_pool &operator=(object_pool const &) = delete;
+
+  ~object_pool() {
+    assert(stats_.in_use == 0 && "pooled objects outlive their pool");
+    for (auto *block : blocks_)
+      ::operator delete(block, std::align_val_t{alignof(T)});
+  }
+
+  // allocates up front, so that not even the first acquisitions miss
+  void reserve(std::size_t n) {
+    auto const lock = std::lock_guard{mutex_};
+    while (stats_.capacity < n)
+      allocate_block();
+    for (; next_ != end_; ++next_) // the last block may still be untouched
+      free_.push_back(next_);
+  }
+
+  template <typename... Args>
+  [[nodiscard]] pool_ptr<T> acquire(Args &&... args) {
+    void *slot = nullptr;
+    {
+      auto const lock = std::lock_guard{mutex_};
+      if (!free_.empty()) {
+        slot = free_.back();
+        free_.pop_back();
+        ++stats_.hits;
+      } else {
+        if (next_ == end_)
+          allocate_block();
+        slot = next_++;
+        ++stats_.misses;
+      }
+      ++stats_.in_use;
+    }
+    try {
+      return {::new (slot) T(std::forward<Args>(args)...), this};
+    } catch (...) {
+      give_back(slot);
+      throw;
+    }
+  }
+
+  [[nodiscard]] pool_stats stats() const {
+    auto const lock = std::lock_guard{mutex_};
+    return stats_;
+  }
+
+private:
+  void recycle(void *object) noexcept override {
+    static_cast<T *>(object)->~T();
+    give_back(object);
+  }
+
+  void give_back(void *slot) noexcept {
+    auto const lock = std::lock_guard{mutex_};
+    free_.push_back(slot); // has room, capacity only ever grows
+    --stats_.in_use;
+  }
+
+  // fresh slots are taken from the current block in address order
+  void allocate_block() {
+    for (; next_ != end_; ++next_) // keep what is left of the previous block
+      free_.push_back(next_);
+    free_.reserve(stats_.capacity + BlockSize);
+    blocks_.reserve(blocks_.size() + 1);
+    next_ = static_cast<T *>(
+        ::operator new(sizeof(T) * BlockSize, std::align_val_t{alignof(T)}));
+    end_ = next_ + BlockSize;
+    blocks_.push_back(next_);
+    stats_.capacity += BlockSize;
+  }
+
+  using mutex_t = std::conditional_t<Threading == pool_threading::shared,
+                                     std::mutex, detail::null_mutex>;
+
+  mutable mutex_t mutex_;
+  std::vector<T *> blocks_;
+  std::vector<void *> free_;
+  T *next_{nullptr};
+  T *end_{nullptr};
+  pool_stats stats_;
+};
+
+} // namespace Tesseract
@@ -0,0 +1,272 @@
+#pragma once
+#include <algorithm>
+#include <bit>
+#include <cassert>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <span>
+#include <type_traits>
+#include <vector>
+
+namespace Tesseract {
+
+/*
+Persistent occupancy map fused from successive radar frames. Every cell holds
+a log-odds value in a small saturating integer (int8_t or int16_t), positive
+for occupied, negative for free, 0 for unknown, and a frame just adds its
+evidence with saturation, so a full resolution map is a few plain integer
+passes that the compiler turns into packed saturating adds and min/max.
+
+Ego motion does not move any memory: the map is a ring buffer in both axes,
+shift() only moves the origin and clears the rows and columns that come into
+view. Rows of the map therefore consist of at most two contiguous pieces of
+the buffer, every kernel below runs over those pieces. Decay pulls every cell
+towards unknown and does not care about the origin at all.
+
+Cells are addressed in map coordinates, x along a row and y across rows, with
+(0, 0) the first cell of the first row, whatever the origin in the buffer.
+*/
+
+/*!
+ * \brief bit_grid          Bit packed yes/no map in row major order, the
+ *                          dynamically sized counterpart of std::bitset
+ */
+class bit_grid {
+public:
+  bit_grid() = default;
+  bit_grid(std::size_t width, std::size_t height)
+      : width_{width}, height_{height},
+        words_((width * height + 63) / 64, 0) {}
+
+  [[nodiscard]] std::size_t width() const noexcept { return width_; }
+  [[nodiscard]] std::size_t height() const noexcept { return height_; }
+  [[nodiscard]] std::size_t size() const noexcept { return width_ * height_; }
+
+  [[nodiscard]] bool test(std::size_t x, std::size_t y) const noexcept {
+    auto const i = y * width_ + x;
+    return words_[i / 64] >> (i % 64) & 1;
+  }
+  [[nodiscard]] std::size_t count() const noexcept {
+    auto n = std::size_t{0};
+    for (auto const w : words_)
+      n += static_cast<std::size_t>(std::popcount(w));
+    return n;
+  }
+  [[nodiscard]] bool any() const noexcept { return count() != 0; }
+
+  // bit i % 64 of word i / 64 is cell i, bits beyond size() are 0
+  [[nodiscard]] std::span<std::uint64_t const> words() const noexcept {
+    return words_;
+  }
+  [[nodiscard]] std::span<std::uint64_t> words() noexcept { return words_; }
+
+private:
+  std::size_t width_{0};
+  std::size_t height_{0};
+  std::vector<std::uint64_t> words_;
+};
+
+/*!
+ * \brief occupancy_grid    Log-odds map in a ring buffer
+ * \tparam Cell             std::int8_t or std::int16_t, values saturate at
+ *                          +-limit so that decay stays symmetric
+ * \param width, height     Cells per row and rows
+ */
+template <typename Cell = std::int8_t> class occupancy_grid {
+  static_assert(std::is_same_v<Cell, std::int8_t> ||
+                    std::is_same_v<Cell, std::int16_t>,
+                "log-odds cells are int8_t or int16_t");
+
+public:
+  static constexpr int limit = std::numeric_limits<Cell>::max();
+
+  occupancy_grid(std::size_t width, std::size_t height)
+      : width_{width}, height_{height}, cells_(width * height, 0) {
+    assert(width > 0 && height > 0);
+  }
+
+  /*!
+   * \brief for_sensor      Map around a forward looking sensor, x ahead up
+   *                        to maxRange_ and y to either side
+   * \param cell_size       Edge of a cell in metres
+   */
+  template <typename Sensor>
+  static occupancy_grid for_sensor(Sensor const &sensor, double cell_size) {
+    auto const r = static_cast<double>(
+        static_cast<long double>(sensor.maxRange_));
+    auto const n = static_cast<std::size_t>(std::ceil(r / cell_size));
+    return {n, 2 * n};
+  }
+
+  [[nodiscard]] std::size_t width() const noexcept { return width_; }
+  [[nodiscard]] std::size_t height() const noexcept { return height_; }
+
+  [[nodiscard]] Cell at(std::size_t x, std::size_t y) const noexcept {
+    return cells_[index(x, y)];
+  }
+  Cell &at(std::size_t x, std::size_t y) noexcept {
+    return cells_[index(x, y)];
+  }
+
+  // occupancy probability of a cell, a cell value of 1 / scale is 1 in
+  // log-odds
+  [[nodiscard]] float probability(std::size_t x, std::size_t y,
+                                  float scale = 0.05F) const noexcept {
+    return 1 / (1 + std::exp(-scale * static_cast<float>(at(x, y))));
+  }
+
+  /*!
+   * \brief fuse            Adds the log-odds evidence of one frame
+   * \param evidence        width() x height() values in map coordinates,
+   *                        positive for hits, negative for seen free
+   */
+  void fuse(std::span<Cell const> evidence) noexcept {
+    assert(evidence.size() == cells_.size());
+    for_each_piece([&](Cell *cells, std::size_t x, std::size_t y,
+                       std::size_t n) {
+      auto const *const in = evidence.data() + y * width_ + x;
+      for (std::size_t i = 0; i < n; ++i)
+        cells[i] = saturate(cells[i] + in[i]);
+    });
+  }
+
+  /*!
+   * \brief fuse            Same for a frame of detection strength, e.g. a
+   *                        rendered power grid: values above threshold are
+   *                        hits, the others are seen free
+   * \param hit, miss       Evidence of either case, miss is usually negative
+   *                        and smaller in magnitude
+   */
+  void fuse(std::span<float const> frame, float threshold, Cell hit,
+            Cell miss) noexcept {
+    assert(frame.size() == cells_.size());
+    for_each_piece([&](Cell *cells, std::size_t x, std::size_t y,
+                       std::size_t n) {
+      auto const *const in = frame.data() + y * width_ + x;
+      for (std::size_t i = 0; i < n; ++i)
+        cells[i] = saturate(cells[i] + (in[i] > threshold ? hit : miss));
+    });
+  }
+
+  // moves every cell step closer to unknown, without overshooting
+  void decay(Cell step) noexcept {
+    assert(step >= 0);
+    auto *const cells = cells_.data();
+    for (std::size_t i = 0, n = cells_.size(); i < n; ++i) {
+      int const c = cells[i];
+      auto const down = c - step > 0 ? c - step : 0;
+      auto const up = c + step < 0 ? c + step : 0;
+      cells[i] = static_cast<Cell>(c > 0 ? down : up);
+    }
+  }
+
+  /*!
+   * \brief shift           Follows the ego motion: afterwards cell (x, y)
+   *                        holds what was cell (x + dx, y + dy) before, the
+   *                        cells that come into view are unknown
+   */
+  void shift(std::ptrdiff_t dx, std::ptrdiff_t dy) noexcept {
+    auto const w = static_cast<std::ptrdiff_t>(width_);
+    auto const h = static_cast<std::ptrdiff_t>(height_);
+    if (std::abs(dx) >= w || std::abs(dy) >= h) {
+      std::fill(cells_.begin(), cells_.end(), Cell{0});
+      return;
+    }
+    origin_x_ = static_cast<std::size_t>(
+        (static_cast<std::ptrdiff_t>(origin_x_) + dx % w + w) % w);
+    origin_y_ = static_cast<std::size_t>(
+        (static_cast<std::ptrdiff_t>(origin_y_) + dy % h + h) % h);
+    // rows that came into view, then the columns in all other rows
+    auto const new_rows = static_cast<std::size_t>(std::abs(dy));
+    auto const first_row = dy > 0 ? height_ - new_rows : 0;
+    for (auto y = first_row; y < first_row + new_rows; ++y)
+      std::fill_n(cells_.data() + physical_row(y) * width_, width_, Cell{0});
+    auto const new_columns = static_cast<std::size_t>(std::abs(dx));
+    if (new_columns == 0)
+      return;
+    auto const first_column = dx > 0 ? width_ - new_columns : 0;
+    for (std::size_t y = 0; y < height_; ++y) {
+      if (y >= first_row && y < first_row + new_rows)
+        continue;
+      auto *const row = cells_.data() + physical_row(y) * width_;
+      auto const begin = (first_column + origin_x_) % width_;
+      auto const head = std::min(new_columns, width_ - begin);
+      std::fill_n(row + begin, head, Cell{0});
+      std::fill_n(row, new_columns - head, Cell{0});
+    }
+  }
+
+  // cells above threshold, in map coordinates
+  [[nodiscard]] bit_grid occupied(Cell threshold = 0) const {
+    return export_bits([threshold](Cell c) { return c > threshold; });
+  }
+  // cells below -threshold
+  [[nodiscard]] bit_grid free(Cell threshold = 0) const {
+    return export_bits([threshold](Cell c) { return c < -threshold; });
+  }
+
+private:
+  [[nodiscard]] static Cell saturate(int v) noexcept {
+    v = v < -limit ? -limit : v;
+    return static_cast<Cell>(v > limit ? limit : v);
+  }
+
+  [[nodiscard]] std::size_t physical_row(std::size_t y) const noexcept {
+    auto const r = y + origin_y_;
+    return r < height_ ? r : r - height_;
+  }
+
+  [[nodiscard]] std::size_t index(std::size_t x, std::size_t y) const noexcept {
+    assert(x < width_ && y < height_);
+    auto const c = x + origin_x_;
+    return physical_row(y) * width_ + (c < width_ ? c : c - width_);
+  }
+
+  // f(cells, x, y, n) for every contiguous piece of the buffer, which holds
+  // cells x to x + n - 1 of map row y
+  template <typename F> void for_each_piece(F &&f) {
+    auto const tail = width_ - origin_x_; // map columns before the wrap
+    for (std::size_t y = 0; y < height_; ++y) {
+      auto *const row = cells_.data() + physical_row(y) * width_;
+      f(row + origin_x_, 0, y, tail);
+      if (origin_x_ != 0)
+        f(row, tail, y, origin_x_);
+    }
+  }
+
+  template <typename Predicate>
+  [[nodiscard]] bit_grid export_bits(Predicate const &predicate) const {
+    auto bits = bit_grid{width_, height_};
+    auto words = bits.words();
+    // the map in row major order, one row at a time
+    auto line = std::vector<Cell>(width_);
+    auto i = std::size_t{0}; // bit position in the whole grid
+    for (std::size_t y = 0; y < height_; ++y) {
+      auto const *const row = cells_.data() + physical_row(y) * width_;
+      std::copy(row + origin_x_, row + width_, line.begin());
+      std::copy(row, row + origin_x_, line.begin() + (width_ - origin_x_));
+      auto x = std::size_t{0};
+      for (; x < width_ && i % 64 != 0; ++x, ++i) // up to a word boundary
+        words[i / 64] |= std::uint64_t{predicate(line[x])} << (i % 64);
+      for (; x + 64 <= width_; x += 64, i += 64) {
+        auto word = std::uint64_t{0};
+        for (std::size_t b = 0; b < 64; ++b)
+          word |= std::uint64_t{predicate(line[x + b])} << b;
+        words[i / 64] = word;
+      }
+      for (; x < width_; ++x, ++i)
+        words[i / 64] |= std::uint64_t{predicate(line[x])} << (i % 64);
+    }
+    return bits;
+  }
+
+  std::size_t width_;
+  std::size_t height_;
+  std::size_t origin_x_{0}; // buffer column of map column 0
+  std::size_t origin_y_{0}; // buffer row of map row 0
+  std::vector<Cell> cells_;
+};
+
+} // namespace Tesseract
@@ -0,0 +1,274 @@
+#pragma once
+#include <array>
+#include <cassert>
+#include <cstddef>
+#include <deque>
+#include <iterator>
+#include <memory>
+#include <memory_resource>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/*
+A persistent vector in the form of a chunked trie with a branching factor of
+2^Bits, elements are kept in leaves of 2^Bits values and the last, partially
+filled leaf is held aside as the tail so that push_back is amortized O(1).
+Copying the vector copies two pointers, the copies share all nodes. A mutation
+only copies the nodes on the path from the root to the touched leaf that are
+shared with another version, nodes owned exclusively by this instance are
+updated in place. Hence a snapshot costs O(1) and the first edit after a
+snapshot O(log n) instead of a copy of the whole container.
+
+Nodes and leaves come from the memory resource of the vector's allocator, so a
+document built on a frame arena does not touch the heap, and elements are
+constructed with the same allocator if they are allocator aware.
+*/
+template <typename T, unsigned Bits = 5> class persistent_vector {
+  static constexpr std::size_t branching = std::size_t{1} << Bits;
+  static constexpr std::size_t mask = branching - 1;
+
+  struct node_t {};
+  using node_ptr = std::shared_ptr<node_t>;
+  struct inner_t : node_t {
+    std::array<node_ptr, branching> children;
+  };
+  // values(resource), braces would pick the initializer_list constructor
+  // for element types that convert from anything
+  struct leaf_t : node_t {
+    explicit leaf_t(std::pmr::memory_resource *resource) : values(resource) {
+      values.reserve(branching);
+    }
+    leaf_t(leaf_t const &other, std::pmr::memory_resource *resource)
+        : node_t{}, values(resource) {
+      values.reserve(branching);
+      values.insert(values.end(), other.values.begin(), other.values.end());
+    }
+    std::pmr::vector<T> values;
+  };
+
+public:
+  using allocator_type = std::pmr::polymorphic_allocator<T>;
+  using value_type = T;
+  using size_type = std::size_t;
+  using reference = T &;
+  using const_reference = T const &;
+
+  class const_iterator {
+  public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = T;
+    using difference_type = std::ptrdiff_t;
+    using pointer = T const *;
+    using reference = T const &;
+
+    const_iterator() = default;
+    reference operator*() const { return leaf_[index_ & mask]; }
+    pointer operator->() const { return &**this; }
+    const_iterator &operator++() {
+      if ((++index_ & mask) == 0 && index_ < vec_->size_)
+        leaf_ = vec_->leaf_for(index_)->values.data();
+      return *this;
+    }
+    const_iterator operator++(int) {
+      auto tmp{*this};
+      ++*this;
+      return tmp;
+    }
+    friend bool operator==(const_iterator const &lhs,
+                           const_iterator const &rhs) {
+      return lhs.index_ == rhs.index_;
+    }
+    friend bool operator!=(const_iterator const &lhs,
+                           const_iterator const &rhs) {
+      return !(lhs == rhs);
+    }
+
+  private:
+    friend persistent_vector;
+    const_iterator(persistent_vector const *vec, size_type index)
+        : vec_{vec}, index_{index},
+          leaf_{index < vec->size_ ? vec->leaf_for(index)->values.data()
+                                   : nullptr} {}
+
+    persistent_vector const *vec_{nullptr};
+    size_type index_{0};
+    T const *leaf_{nullptr};
+  };
+
+  persistent_vector() = default;
+  explicit persistent_vector(allocator_type alloc)
+      : resource_{alloc.resource()} {}
+
+  [[nodiscard]] allocator_type get_allocator() const noexcept {
+    return allocator_type{resource_};
+  }
+
+  [[nodiscard]] size_type size() const noexcept { return size_; }
+  [[nodiscard]] bool empty() const noexcept { return size_ == 0; }
+
+  const_iterator begin() const { return {this, 0}; }
+  const_iterator end() const { return {this, size_}; }
+  const_iterator cbegin() const { return begin(); }
+  const_iterator cend() const { return end(); }
+
+  const_reference operator[](size_type i) const {
+    assert(i < size_);
+    return leaf_for(i)->values[i & mask];
+  }
+
+  // Path-copies the leaf holding element i unless it is already owned
+  // exclusively, reading through a const reference never copies anything
+  reference operator[](size_type i) {
+    assert(i < size_);
+    if (i >= tail_offset())
+      return unique<leaf_t>(tail_).values[i & mask];
+    auto *slot = &unique<inner_t>(root_).children[(i >> shift_) & mask];
+    for (auto level = shift_; level > Bits; level -= Bits)
+      slot = &unique<inner_t>(*slot).children[(i >> (level - Bits)) & mask];
+    return unique<leaf_t>(*slot).values[i & mask];
+  }
+
+  void push_back(T x) {
+    if (size_ - tail_offset() == branching) {
+      push_tail();
+      tail_.reset();
+    }
+    unique<leaf_t>(tail_).values.push_back(std::move(x));
+    ++size_;
+  }
+
+  template <typename... Args> void emplace_back(Args &&... args) {
+    push_back(std::make_obj_using_allocator<T>(get_allocator(),
+                                               std::forward<Args>(args)...));
+  }
+
+  // Calls f(T const *, size_type) once per leaf, i.e. with contiguous chunks
+  // of at most 2^Bits elements in order
+  template <typename F> void for_each_chunk(F &&f) const {
+    for (size_type i = 0; i < size_; i += branching) {
+      auto const &values = leaf_for(i)->values;
+      f(values.data(), values.size());
+    }
+  }
+
+private:
+  // node and control block in one allocation from the vector's resource
+  template <typename N, typename... Args>
+  std::shared_ptr<N> make(Args const &... args) const {
+    if constexpr (std::is_same_v<N, leaf_t>)
+      return std::allocate_shared<N>(get_allocator(), args..., resource_);
+    else
+      return std::allocate_shared<N>(get_allocator(), args...);
+  }
+
+  template <typename N> N &unique(node_ptr &node) {
+    if (!node)
+      node = make<N>();
+    else if (node.use_count() != 1)
+      node = make<N>(static_cast<N const &>(*node));
+    return static_cast<N &>(*node);
+  }
+
+  size_type tail_offset() const noexcept {
+    return size_ < branching ? 0 : ((size_ - 1) >> Bits) << Bits;
+  }
+
+  leaf_t const *leaf_for(size_type i) const {
+    if (i >= tail_offset())
+      return static_cast<leaf_t const *>(tail_.get());
+    auto const *node = root_.get();
+    for (auto level = shift_; level > 0; level -= Bits)
+      node = static_cast<inner_t const *>(node)
+                 ->children[(i >> level) & mask]
+                 .get();
+    return static_cast<leaf_t const *>(node);
+  }
+
+  node_ptr new_path(unsigned level, node_ptr node) const {
+    if (level == 0)
+      return node;
+    auto parent = make<inner_t>();
+    parent->children[0] = new_path(level - Bits, std::move(node));
+    return parent;
+  }
+
+  // moves the full tail into the trie, the root grows by one level as soon
+  // as it cannot address the new leaf anymore
+  void push_tail() {
+    if (!root_) {
+      auto root = make<inner_t>();
+      root->children[0] = std::move(tail_);
+      root_ = std::move(root);
+      return;
+    }
+    if ((size_ >> Bits) > (size_type{1} << shift_)) {
+      auto root = make<inner_t>();
+      root->children[0] = std::move(root_);
+      root->children[1] = new_path(shift_, std::move(tail_));
+      root_ = std::move(root);
+      shift_ += Bits;
+      return;
+    }
+    auto *slot = &root_;
+    for (auto level = shift_; level > Bits; level -= Bits) {
+      auto &child =
+          unique<inner_t>(*slot).children[((size_ - 1) >> level) & mask];
+      if (!child) {
+        child = new_path(level - Bits, std::move(tail_));
+        return;
+      }
+      slot = &child;
+    }
+    unique<inner_t>(*slot).children[((size_ - 1) >> Bits) & mask] =
+        std::move(tail_);
+  }
+
+  size_type size_{0};
+  unsigned shift_{Bits}; // number of index bits consumed above the leaves
+  node_ptr root_;
+  node_ptr tail_;
+  // not the allocator itself, polymorphic_allocator is not assignable; an
+  // assignment takes over the resource along with the shared nodes
+  std::pmr::memory_resource *resource_{std::pmr::get_default_resource()};
+};
+
+/*!
+ * \brief basic_history           Undo stack of persistent documents
+ * \param capacity                Maximum number of kept snapshots, 0 keeps
+ *                                all of them. Once the cap is exceeded the
+ *                                oldest snapshot is dropped, which releases
+ *                                every node no newer version still refers to
+ */
+template <typename Document> class basic_history {
+public:
+  explicit basic_history(std::size_t capacity = 0) : capacity_{capacity} {
+    snapshots_.emplace_back();
+  }
+
+  void commit() {
+    snapshots_.push_back(snapshots_.back()); // shares all nodes, O(1)
+    if (capacity_ && snapshots_.size() > capacity_)
+      snapshots_.pop_front();
+  }
+  void undo() {
+    assert(snapshots_.size() > 1);
+    snapshots_.pop_back();
+  }
+  Document &current() { return snapshots_.back(); }
+  Document const &current() const { return snapshots_.back(); }
+
+  [[nodiscard]] std::size_t size() const noexcept { return snapshots_.size(); }
+  [[nodiscard]] std::size_t capacity() const noexcept { return capacity_; }
+
+  // keeps the most recent n snapshots only
+  void compact(std::size_t n) {
+    assert(n > 0);
+    while (snapshots_.size() > n)
+      snapshots_.pop_front();
+  }
+
+private:
+  std::size_t capacity_;
+  std::deque<Document> snapshots_;
+};
@@ -0,0 +1,314 @@
+#pragma once
+#include "threadPool.hpp"
+#include <array>
+#include <condition_variable>
+#include <coroutine>
+#include <cstddef>
+#include <exception>
+#include <mutex>
+#include <semaphore>
+#include <stdexcept>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace Tesseract {
+
+/*
+Runs the features of a Radar model over a stream of frames. Every feature
+that has a member stage(frame) is one stage of the pipeline, in the order of
+the feature list, which is found at compile time from Radar::features. A
+stage either returns void and is plain compute, or returns an awaitable (e.g.
+a stage_task coroutine that waits for I/O) that is co_awaited without holding
+a thread.
+
+Each frame is a coroutine that hops onto the pool and walks through the
+stages. A stage sees the frames one at a time and in push order, so features
+keep their state without locks, but different stages work on different
+frames at the same time: while frame n is beamformed, frame n + 1 is already
+acquired. A frame that reaches a stage before its predecessor left it parks
+its coroutine there and is resumed by the predecessor, no worker ever blocks.
+
+At most max_in_flight frames are in the pipeline, push() blocks the producer
+until the oldest one is through (backpressure). The frames live in as many
+slots that are reused round robin, since frames leave the last stage in push
+order.
+*/
+
+/*!
+ * \brief stage_task        Lazy coroutine a feature may return from stage()
+ *                          for asynchronous work, it starts when awaited and
+ *                          resumes the awaiting frame when done
+ */
+class [[nodiscard]] stage_task {
+public:
+  struct promise_type {
+    std::coroutine_handle<> continuation{std::noop_coroutine()};
+    std::exception_ptr error;
+
+    stage_task get_return_object() noexcept {
+      return stage_task{
+          std::coroutine_handle<promise_type>::from_promise(*this)};
+    }
+    std::suspend_always initial_suspend() noexcept { return {}; }
+    auto final_suspend() noexcept {
+      struct resume_continuation {
+        bool await_ready() noexcept { return false; }
+        std::coroutine_handle<>
+        await_suspend(std::coroutine_handle<promise_type> h) noexcept {
+          return h.promise().continuation;
+        }
+        void await_resume() noexcept {}
+      };
+      return resume_continuation{};
+    }
+    void return_void() noexcept {}
+    void unhandled_exception() noexcept { error = std::current_exception(); }
+  };
+
+  stage_task(stage_task &&other) noexcept
+      : handle_{std::exchange(other.handle_, nullptr)} {}
+  stage_task &operator=(stage_task other) noexcept {
+    std::swap(handle_, other.handle_);
+    return *this;
+  }
+  ~stage_task() {
+    if (handle_)
+      handle_.destroy();
+  }
+
+  bool await_ready() const noexcept { return !handle_ || handle_.done(); }
+  std::coroutine_handle<>
+  await_suspend(std::coroutine_handle<> awaiting) noexcept {
+    handle_.promise().continuation = awaiting;
+    return handle_;
+  }
+  void await_resume() const {
+    if (handle_ && handle_.promise().error)
+      std::rethrow_exception(handle_.promise().error);
+  }
+
+private:
+  explicit stage_task(std::coroutine_handle<promise_type> handle) noexcept
+      : handle_{handle} {}
+
+  std::coroutine_handle<promise_type> handle_;
+};
+
+/*!
+ * \brief schedule_on       co_await schedule_on(pool) continues the
+ *                          coroutine on a worker of the pool
+ */
+struct schedule_on {
+  thread_pool &pool;
+
+  bool await_ready() const noexcept { return false; }
+  void await_suspend(std::coroutine_handle<> h) const {
+    pool.post([h] { h.resume(); });
+  }
+  void await_resume() const noexcept {}
+};
+
+template <typename Feature, typename Frame>
+concept frame_stage = requires(Feature &feature, Frame &frame) {
+  feature.stage(frame);
+};
+
+namespace detail {
+
+// started eagerly and destroyed when it runs off its end
+struct detached_task {
+  struct promise_type {
+    detached_task get_return_object() noexcept { return {}; }
+    std::suspend_never initial_suspend() noexcept { return {}; }
+    std::suspend_never final_suspend() noexcept { return {}; }
+    void return_void() noexcept {}
+    void unhandled_exception() noexcept { std::terminate(); }
+  };
+};
+
+} // namespace detail
+
+/*!
+ * \brief frame_pipeline    Staged processing of frames by the features of a
+ *                          Radar model
+ * \tparam Model            Radar<Identity, Features...>
+ * \tparam Frame            Whatever the stages take, default constructible
+ *                          and move assignable
+ * \param model             Outlives the pipeline, its features are the stages
+ * \param max_in_flight     Frames in the pipeline at the same time
+ */
+template <typename Model, typename Frame> class frame_pipeline {
+  using features = typename Model::features;
+  static constexpr auto feature_count = std::tuple_size_v<features>;
+
+  template <std::size_t I>
+  static constexpr bool is_stage =
+      frame_stage<std::tuple_element_t<I, features>, Frame>;
+
+  using stage_fn = stage_task (frame_pipeline::*)(Frame &);
+
+  // member function per stage in feature order, built where the class is
+  // complete
+  static constexpr auto make_stages() {
+    return []<std::size_t... I>(std::index_sequence<I...>) {
+      auto table = std::array<stage_fn, stage_count>{};
+      auto k = std::size_t{0};
+      (
+          [&] {
+            if constexpr (is_stage<I>)
+              table[k++] = &frame_pipeline::template call<I>;
+          }(),
+          ...);
+      return table;
+    }(std::make_index_sequence<feature_count>{});
+  }
+
+public:
+  static constexpr auto stage_count =
+      []<std::size_t... I>(std::index_sequence<I...>) {
+        return (std::size_t{is_stage<I>} + ... + 0);
+      }(std::make_index_sequence<feature_count>{});
+
+  frame_pipeline(Model &model, thread_pool &pool,
+                 std::size_t max_in_flight = 4)
+      : model_{model}, pool_{pool}, slots_(max_in_flight),
+        free_slots_{static_cast<std::ptrdiff_t>(max_in_flight)},
+        gates_(stage_count) {
+    if (max_in_flight == 0)
+      throw std::invalid_argument("frame_pipeline needs a frame in flight");
+    for (auto &gate : gates_)
+      gate.parked.resize(max_in_flight);
+  }
+
+  frame_pipeline(frame_pipeline const &) = delete;
+  frame_pipeline &operator=(frame_pipeline const &) = delete;
+  ~frame_pipeline() { wait_idle(); }
+
+  /*!
+   * \brief push            Sends a frame through all stages, blocks while
+   *                        max_in_flight frames are in the pipeline. Must be
+   *                        called from outside the pool
+   * \return                Sequence number of the frame, starting at 0
+   */
+  std::size_t push(Frame frame) {
+    free_slots_.acquire();
+    auto index = std::size_t{0};
+    {
+      std::lock_guard lock{mutex_};
+      index = pushed_++;
+    }
+    slots_[index % slots_.size()] = std::move(frame);
+    run(index);
+    return index;
+  }
+
+  /*!
+   * \brief wait            Until every pushed frame left the last stage,
+   *                        rethrows the first exception of a stage
+   */
+  void wait() {
+    wait_idle();
+    std::lock_guard lock{mutex_};
+    if (error_)
+      std::rethrow_exception(std::exchange(error_, nullptr));
+  }
+
+  [[nodiscard]] std::size_t max_in_flight() const noexcept {
+    return slots_.size();
+  }
+
+private:
+  // a stage lets frame index through once index - 1 has left it
+  struct gate {
+    std::mutex mutex;
+    std::size_t turn{0};
+    std::vector<std::coroutine_handle<>> parked; // by slot
+  };
+
+  struct enter {
+    frame_pipeline &pipeline;
+    std::size_t stage, index;
+
+    bool await_ready() const noexcept { return false; }
+    bool await_suspend(std::coroutine_handle<> h) const {
+      auto &g = pipeline.gates_[stage];
+      std::lock_guard lock{g.mutex};
+      if (g.turn == index)
+        return false;
+      g.parked[index % g.parked.size()] = h;
+      return true;
+    }
+    void await_resume() const noexcept {}
+  };
+
+  void leave(std::size_t stage, std::size_t index) {
+    auto &g = gates_[stage];
+    std::coroutine_handle<> next;
+    {
+      std::lock_guard lock{g.mutex};
+      g.turn = index + 1;
+      next = std::exchange(g.parked[(index + 1) % g.parked.size()], nullptr);
+    }
+    if (next)
+      pool_.post([next] { next.resume(); });
+  }
+
+  template <std::size_t I> stage_task call(Frame &frame) {
+    auto &feature = static_cast<std::tuple_element_t<I, features> &>(model_);
+    if constexpr (std::is_void_v<decltype(feature.stage(frame))>)
+      feature.stage(frame);
+    else
+      co_await feature.stage(frame);
+    co_return;
+  }
+
+  // a frame whose stage threw only passes the remaining gates
+  detail::detached_task run(std::size_t index) {
+    static constexpr auto stages = make_stages();
+    co_await schedule_on{pool_};
+    auto &frame = slots_[index % slots_.size()];
+    auto failed = false;
+    for (std::size_t s = 0; s < stage_count; ++s) {
+      co_await enter{*this, s, index};
+      if (!failed) {
+        try {
+          co_await (this->*stages[s])(frame);
+        } catch (...) {
+          failed = true;
+          std::lock_guard lock{mutex_};
+          if (!error_)
+            error_ = std::current_exception();
+        }
+      }
+      leave(s, index);
+    }
+    finish();
+  }
+
+  void finish() {
+    free_slots_.release();
+    std::lock_guard lock{mutex_};
+    if (++finished_ == pushed_)
+      idle_.notify_all();
+  }
+
+  void wait_idle() {
+    std::unique_lock lock{mutex_};
+    idle_.wait(lock, [this] { return finished_ == pushed_; });
+  }
+
+  Model &model_;
+  thread_pool &pool_;
+  std::vector<Frame> slots_;
+  std::counting_semaphore<> free_slots_;
+  std::vector<gate> gates_;
+  std::mutex mutex_;
+  std::condition_variable idle_;
+  std::size_t pushed_{0};
+  std::size_t finished_{0};
+  std::exception_ptr error_;
+};
+
+} // namespace Tesseract
@@ -1,5 +1,6 @@
 #pragma once
 #include "SI-lib.hpp"
+#include <tuple>
 #include <type_traits>
 #include "radarPolicies.hpp"
 
@@ -18,6 +19,9 @@ enum class Layout {
 template<class _Identity, template<typename...> class ...__Features>
 struct Radar : _Identity, __Features<Radar<_Identity, __Features...>> ... {
 
+  // the feature bases in declaration order, e.g. for Tesseract::frame_pipeline
+  using features = std::tuple<__Features<Radar>...>;
+
   constexpr explicit Radar(Layout layout) {
     std::cout << sizeof...(__Features) << std::endl;
   }
@@ -1,4 +1,13 @@
 #pragma once
+#include "beamformer.hpp"
+#include <complex>
+#include <cstddef>
+#include <memory_resource>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <utility>
 
 using namespace si;
 
@@ -6,10 +15,20 @@ namespace radar::features {
 
 template<typename... __Implementation>
 struct B {
+  // allocator aware, so that a frame_arena propagates into the member
+  using allocator_type = std::pmr::polymorphic_allocator<char>;
+
   B() = default;
-  B(std::string_view b) : b_{b} {}
+  explicit B(allocator_type alloc) : b_{alloc} {}
+  B(std::string_view b, allocator_type alloc = {}) : b_{b, alloc} {}
+  B(B const &other, allocator_type alloc) : b_{other.b_, alloc} {}
+  B(B &&other, allocator_type alloc) : b_{std::move(other.b_), alloc} {}
+  B(B const &) = default;
+  B(B &&) = default;
+  B &operator=(B const &) = default;
+  B &operator=(B &&) = default;
 
-  std::string b_;
+  std::pmr::string b_;
 };
 
 template<typename _Impl>
@@ -63,6 +82,43 @@ struct Grid : crtp<_Interface> {
   }
 };
 
+// angle bins from per antenna range-Doppler maps, numberOfAngularBeams of them
+// as the radar type specifies; the beamformer is built on first use and again
+// only if the array changes
+template<typename _Radar>
+struct Beamforming {
+  using cell_type = Tesseract::beamformer::value_type;
+
+  void beamform(std::span<cell_type const> maps, std::size_t channels,
+                std::span<cell_type> beams, double spacing = 0.5) {
+    auto const &radar = static_cast<_Radar const &>(*this);
+    auto const count = static_cast<std::size_t>(radar.numberOfAngularBeams);
+    if (!beamformer_ || beamformer_->channels() != channels ||
+        beamformer_->beams() != count || spacing_ != spacing) {
+      beamformer_.emplace(channels, count, spacing);
+      spacing_ = spacing;
+    }
+    (*beamformer_)(maps, beams);
+  }
+
+  // pipeline stage for frames that carry maps, channels and beams
+  template<typename Frame>
+    requires requires(Frame &frame) {
+      frame.maps;
+      frame.channels;
+      frame.beams;
+    }
+  void stage(Frame &frame) {
+    beamform(frame.maps, frame.channels, frame.beams);
+  }
+
+  [[nodiscard]] auto const &beamformer() const { return beamformer_; }
+
+ private:
+  std::optional<Tesseract::beamformer> beamformer_;
+  double spacing_{0};
+};
+
 } // namespace radar::features
 
 namespace radar::type {
@@ -0,0 +1,276 @@
+#pragma once
+#include "threadPool.hpp"
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <numeric>
+#include <span>
+#include <type_traits>
+#include <vector>
+
+namespace Tesseract {
+
+/*
+Stable LSD radix sort over 8 bit digits for integral and IEEE floating point
+keys. Keys are first mapped onto unsigned integers whose natural order equals
+the order of the original values, all digit histograms are then gathered in a
+single sweep and every pass whose digit is the same for all keys (e.g. the
+upper bytes of small range bins) is skipped altogether.
+*/
+namespace detail {
+
+template <typename T> struct radix_key {
+  static_assert(std::is_arithmetic_v<T>, "radix sort needs numeric keys");
+  using type = std::conditional_t<sizeof(T) <= 4, std::uint32_t, std::uint64_t>;
+  static constexpr type sign_bit = type{1} << (sizeof(T) * 8 - 1);
+
+  static constexpr type encode(T x) noexcept {
+    if constexpr (std::is_floating_point_v<T>) {
+      // negative values: flip everything, positive ones: flip the sign only
+      auto const bits = static_cast<type>(std::bit_cast<
+          std::conditional_t<sizeof(T) == 4, std::uint32_t, std::uint64_t>>(x));
+      return bits ^ (bits & sign_bit ? ~type{0} : sign_bit);
+    } else if constexpr (std::is_signed_v<T>) {
+      return static_cast<type>(static_cast<std::make_unsigned_t<T>>(x)) ^
+             sign_bit;
+    } else {
+      return static_cast<type>(x);
+    }
+  }
+
+  static constexpr T decode(type k) noexcept {
+    if constexpr (std::is_floating_point_v<T>) {
+      using bits_t =
+          std::conditional_t<sizeof(T) == 4, std::uint32_t, std::uint64_t>;
+      return std::bit_cast<T>(
+          static_cast<bits_t>(k ^ (k & sign_bit ? sign_bit : ~type{0})));
+    } else if constexpr (std::is_signed_v<T>) {
+      return static_cast<T>(
+          static_cast<std::make_unsigned_t<T>>(k ^ sign_bit));
+    } else {
+      return static_cast<T>(k);
+    }
+  }
+};
+
+struct no_payload {};
+
+inline constexpr std::size_t radix = 256;
+
+template <typename K>
+using histograms_t = std::array<std::array<std::size_t, radix>, sizeof(K)>;
+
+template <typename K>
+constexpr std::size_t digit(K key, std::size_t pass) noexcept {
+  return static_cast<std::size_t>(key >> (pass * 8)) & (radix - 1);
+}
+
+// one read of the keys for all passes, four interleaved count tables per
+// pass break the store-to-load dependency between equal consecutive digits
+template <typename K>
+histograms_t<K> histograms(K const *keys, std::size_t n) {
+  constexpr auto passes = sizeof(K);
+  std::vector<std::array<std::array<std::uint32_t, radix>, passes>> lanes(4);
+  for (auto &lane : lanes)
+    for (auto &h : lane)
+      h.fill(0);
+  auto i = std::size_t{0};
+  for (; i + 4 <= n; i += 4)
+    for (std::size_t l = 0; l < 4; ++l)
+      for (std::size_t p = 0; p < passes; ++p)
+        ++lanes[l][p][digit(keys[i + l], p)];
+  for (; i < n; ++i)
+    for (std::size_t p = 0; p < passes; ++p)
+      ++lanes[0][p][digit(keys[i], p)];
+
+  histograms_t<K> result{};
+  for (std::size_t p = 0; p < passes; ++p)
+    for (std::size_t d = 0; d < radix; ++d)
+      result[p][d] =
+          std::size_t{lanes[0][p][d]} + lanes[1][p][d] + lanes[2][p][d] +
+          lanes[3][p][d];
+  return result;
+}
+
+template <typename K, typename V>
+void scatter(K const *keys, K *keys_out, V const *vals, V *vals_out,
+             std::size_t begin, std::size_t end, std::size_t pass,
+             std::size_t *offsets) {
+  for (auto i = begin; i < end; ++i) {
+    auto const pos = offsets[digit(keys[i], pass)]++;
+    keys_out[pos] = keys[i];
+    if constexpr (!std::is_same_v<V, no_payload>)
+      vals_out[pos] = vals[i];
+  }
+}
+
+// keys and vals end up sorted in the first buffers again
+template <typename K, typename V>
+void lsd_sort(K *keys, K *keys_tmp, V *vals, V *vals_tmp, std::size_t n) {
+  if (n < 2)
+    return;
+  auto const counts = histograms(keys, n);
+  bool swapped = false;
+  for (std::size_t pass = 0; pass < sizeof(K); ++pass) {
+    if (counts[pass][digit(keys[0], pass)] == n)
+      continue; // every key has the same digit, nothing would move
+    std::array<std::size_t, radix> offsets;
+    std::exclusive_scan(counts[pass].begin(), counts[pass].end(),
+                        offsets.begin(), std::size_t{0});
+    scatter(keys, keys_tmp, vals, vals_tmp, 0, n, pass, offsets.data());
+    std::swap(keys, keys_tmp);
+    if constexpr (!std::is_same_v<V, no_payload>)
+      std::swap(vals, vals_tmp);
+    swapped = !swapped;
+  }
+  if (swapped) {
+    std::copy_n(keys, n, keys_tmp);
+    if constexpr (!std::is_same_v<V, no_payload>)
+      std::copy_n(vals, n, vals_tmp);
+  }
+}
+
+// Every pass counts the digits of contiguous chunks in parallel, the prefix
+// sum over (digit, chunk) gives each chunk disjoint output slots so that the
+// scatter runs in parallel too and stays stable
+template <typename K, typename V>
+void parallel_lsd_sort(thread_pool &pool, K *keys, K *keys_tmp, V *vals,
+                       V *vals_tmp, std::size_t n) {
+  auto const chunks = std::max<std::size_t>(
+      1, std::min<std::size_t>(pool.size(), n / (std::size_t{1} << 16)));
+  if (chunks == 1)
+    return lsd_sort(keys, keys_tmp, vals, vals_tmp, n);
+
+  auto const chunk_begin = [n, chunks](std::size_t c) {
+    return n * c / chunks;
+  };
+  auto offsets = std::vector<std::array<std::size_t, radix>>(chunks);
+  bool swapped = false;
+  for (std::size_t pass = 0; pass < sizeof(K); ++pass) {
+    {
+      task_group group{pool};
+      for (std::size_t c = 0; c < chunks; ++c)
+        group.run([&, c] {
+          auto &h = offsets[c];
+          h.fill(0);
+          for (auto i = chunk_begin(c); i < chunk_begin(c + 1); ++i)
+            ++h[digit(keys[i], pass)];
+        });
+    }
+    std::size_t sum{0};
+    std::size_t first_digit_total{0};
+    for (std::size_t d = 0; d < radix; ++d)
+      for (std::size_t c = 0; c < chunks; ++c) {
+        auto const count = offsets[c][d];
+        if (d == digit(keys[0], pass))
+          first_digit_total += count;
+        offsets[c][d] = sum;
+        sum += count;
+      }
+    if (first_digit_total == n)
+      continue;
+    {
+      task_group group{pool};
+      for (std::size_t c = 0; c < chunks; ++c)
+        group.run([&, c] {
+          scatter(keys, keys_tmp, vals, vals_tmp, chunk_begin(c),
+                  chunk_begin(c + 1), pass, offsets[c].data());
+        });
+    }
+    std::swap(keys, keys_tmp);
+    if constexpr (!std::is_same_v<V, no_payload>)
+      std::swap(vals, vals_tmp);
+    swapped = !swapped;
+  }
+  if (swapped) {
+    std::copy_n(keys, n, keys_tmp);
+    if constexpr (!std::is_same_v<V, no_payload>)
+      std::copy_n(vals, n, vals_tmp);
+  }
+}
+
+template <typename T>
+std::vector<typename radix_key<T>::type> encode_all(std::span<T const> xs) {
+  auto keys = std::vector<typename radix_key<T>::type>(xs.size());
+  std::transform(xs.begin(), xs.end(), keys.begin(), radix_key<T>::encode);
+  return keys;
+}
+
+template <typename T>
+void decode_all(std::vector<typename radix_key<T>::type> const &keys,
+                std::span<T> xs) {
+  std::transform(keys.begin(), keys.end(), xs.begin(), radix_key<T>::decode);
+}
+
+} // namespace detail
+
+/*!
+ * \brief radix_sort                Sorts numeric keys in O(n), e.g. range
+ *                                  bins, SNR values or timestamps
+ * \param keys                      Integral or floating point values, NaNs
+ *                                  end up at either end depending on sign
+ */
+template <typename T> void radix_sort(std::span<T> keys) {
+  auto encoded = detail::encode_all(std::span<T const>{keys});
+  auto tmp = decltype(encoded)(encoded.size());
+  detail::no_payload none;
+  detail::lsd_sort(encoded.data(), tmp.data(), &none, &none, encoded.size());
+  detail::decode_all(encoded, keys);
+}
+
+/*!
+ * \brief radix_sort                Sorts values by their numeric keys, both
+ * \param keys                      spans have to be of the same size, equal
+ * \param values                    keys keep the order of their values
+ */
+template <typename T, typename V>
+void radix_sort(std::span<T> keys, std::span<V> values) {
+  auto encoded = detail::encode_all(std::span<T const>{keys});
+  auto tmp = decltype(encoded)(encoded.size());
+  auto values_tmp = std::vector<V>(values.size());
+  detail::lsd_sort(encoded.data(), tmp.data(), values.data(),
+                   values_tmp.data(), encoded.size());
+  detail::decode_all(encoded, keys);
+}
+
+/*!
+ * \brief radix_argsort             Stable permutation index that sorts keys,
+ *                                  i.e. keys[index[0]] is the smallest one
+ * \param keys                      Left untouched
+ */
+template <typename Index = std::uint32_t, typename T>
+[[nodiscard]] std::vector<Index> radix_argsort(std::span<T const> keys) {
+  auto encoded = detail::encode_all(keys);
+  auto tmp = decltype(encoded)(encoded.size());
+  auto index = std::vector<Index>(keys.size());
+  std::iota(index.begin(), index.end(), Index{0});
+  auto index_tmp = std::vector<Index>(keys.size());
+  detail::lsd_sort(encoded.data(), tmp.data(), index.data(), index_tmp.data(),
+                   encoded.size());
+  return index;
+}
+
+template <typename T>
+void parallel_radix_sort(thread_pool &pool, std::span<T> keys) {
+  auto encoded = detail::encode_all(std::span<T const>{keys});
+  auto tmp = decltype(encoded)(encoded.size());
+  detail::no_payload none;
+  detail::parallel_lsd_sort(pool, encoded.data(), tmp.data(), &none, &none,
+                            encoded.size());
+  detail::decode_all(encoded, keys);
+}
+
+template <typename T, typename V>
+void parallel_radix_sort(thread_pool &pool, std::span<T> keys,
+                         std::span<V> values) {
+  auto encoded = detail::encode_all(std::span<T const>{keys});
+  auto tmp = decltype(encoded)(encoded.size());
+  auto values_tmp = std::vector<V>(values.size());
+  detail::parallel_lsd_sort(pool, encoded.data(), tmp.data(), values.data(),
+                            values_tmp.data(), encoded.size());
+  detail::decode_all(encoded, keys);
+}
+
+} // namespace Tesseract
@@ -0,0 +1,271 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace Tesseract {
+
+/*
+Name to value tables for factories and decoders that are resolved per message.
+Both look keys up as std::string_view, so neither a std::string nor a NUL
+terminator is needed, and both cost one hash plus one key comparison in the
+common case:
+
+  flat_registry     filled at run time, open addressing with linear probing
+                    over a flat array of (hash, index) slots, keys and values
+                    are kept densely in insertion order
+  static_registry   keys known at compile time, a perfect hash is searched by
+                    the compiler (hash and displace), hence a lookup never
+                    probes and misses are rejected after a single comparison
+*/
+
+namespace detail {
+
+// FNV-1a with a final avalanche, so that the low bits used as the table index
+// depend on every input byte
+constexpr std::uint64_t registry_hash(std::string_view key) noexcept {
+  auto h = 0xcbf29ce484222325ULL;
+  for (auto const c : key)
+    h = (h ^ static_cast<unsigned char>(c)) * 0x100000001b3ULL;
+  h ^= h >> 32;
+  h *= 0xd6e8feb86659fd93ULL;
+  return h ^ (h >> 32);
+}
+
+// derives further hashes from the first one without touching the key again
+constexpr std::uint64_t registry_rehash(std::uint64_t h,
+                                        std::uint64_t seed) noexcept {
+  h ^= seed * 0x9e3779b97f4a7c15ULL;
+  h ^= h >> 31;
+  h *= 0xbf58476d1ce4e5b9ULL;
+  return h ^ (h >> 29);
+}
+
+} // namespace detail
+
+/*!
+ * \brief flat_registry     Open addressing hash table from names to values
+ *                          with heterogeneous lookup. Entries can be added
+ *                          and replaced but not removed, which is all a
+ *                          registry needs and keeps probing tombstone-free
+ */
+template <typename V> class flat_registry {
+public:
+  flat_registry() = default;
+  flat_registry(std::initializer_list<std::pair<std::string_view, V>> init) {
+    reserve(init.size());
+    for (auto const &[key, value] : init)
+      insert_or_assign(key, value);
+  }
+
+  [[nodiscard]] std::size_t size() const noexcept { return keys_.size(); }
+  [[nodiscard]] bool empty() const noexcept { return keys_.empty(); }
+
+  void reserve(std::size_t n) {
+    keys_.reserve(n);
+    values_.reserve(n);
+    if (2 * n > slots_.size())
+      rehash(std::bit_ceil(std::max<std::size_t>(2 * n, 8)));
+  }
+
+  // returns true if the key was new
+  template <typename T> bool insert_or_assign(std::string_view key, T &&value) {
+    auto const h = static_cast<std::uint32_t>(detail::registry_hash(key));
+    if (auto *const v = find(key, h)) {
+      *v = std::forward<T>(value);
+      return false;
+    }
+    if (2 * (keys_.size() + 1) > slots_.size())
+      rehash(std::max<std::size_t>(2 * slots_.size(), 8));
+    keys_.emplace_back(key);
+    values_.emplace_back(std::forward<T>(value));
+    place(h, static_cast<std::uint32_t>(keys_.size()));
+    return true;
+  }
+
+  [[nodiscard]] V *find(std::string_view key) noexcept {
+    return find(key, static_cast<std::uint32_t>(detail::registry_hash(key)));
+  }
+  [[nodiscard]] V const *find(std::string_view key) const noexcept {
+    return const_cast<flat_registry *>(this)->find(key);
+  }
+  [[nodiscard]] bool contains(std::string_view key) const noexcept {
+    return find(key) != nullptr;
+  }
+
+  [[nodiscard]] V const &at(std::string_view key) const {
+    if (auto const *const v = find(key))
+      return *v;
+    throw std::out_of_range{"flat_registry: unknown key"};
+  }
+
+  // names and values in insertion order
+  [[nodiscard]] std::vector<std::string> const &keys() const noexcept {
+    return keys_;
+  }
+  [[nodiscard]] std::vector<V> const &values() const noexcept {
+    return values_;
+  }
+
+private:
+  struct slot {
+    std::uint32_t hash;
+    std::uint32_t index; // one based, 0 marks an empty slot
+  };
+
+  V *find(std::string_view key, std::uint32_t h) noexcept {
+    if (slots_.empty())
+      return nullptr;
+    auto const mask = slots_.size() - 1;
+    for (auto i = std::size_t{h} & mask;; i = (i + 1) & mask) {
+      auto const s = slots_[i];
+      if (s.index == 0)
+        return nullptr;
+      if (s.hash == h && keys_[s.index - 1] == key)
+        return &values_[s.index - 1];
+    }
+  }
+
+  void place(std::uint32_t h, std::uint32_t index) noexcept {
+    auto const mask = slots_.size() - 1;
+    auto i = std::size_t{h} & mask;
+    while (slots_[i].index != 0)
+      i = (i + 1) & mask;
+    slots_[i] = {h, index};
+  }
+
+  void rehash(std::size_t capacity) {
+    slots_.assign(capacity, slot{0, 0});
+    for (std::size_t i = 0; i < keys_.size(); ++i)
+      place(static_cast<std::uint32_t>(detail::registry_hash(keys_[i])),
+            static_cast<std::uint32_t>(i + 1));
+  }
+
+  std::vector<slot> slots_;
+  std::vector<std::string> keys_;
+  std::vector<V> values_;
+};
+
+/*!
+ * \brief static_registry   Perfect hash table over keys known at compile
+ *                          time, usually created by make_static_registry.
+ *                          Keys are split into buckets by one hash, each
+ *                          bucket then gets the first seed that sends all
+ *                          its keys to free slots. V has to be a literal,
+ *                          default constructible type, e.g. a function
+ *                          pointer
+ * \tparam N                Number of keys
+ */
+template <typename V, std::size_t N> class static_registry {
+  static_assert(N > 0, "a static registry needs at least one key");
+  static constexpr std::size_t buckets = N;
+  static constexpr std::size_t capacity = std::bit_ceil(2 * N);
+
+public:
+  using entry = std::pair<std::string_view, V>;
+
+  constexpr explicit static_registry(std::array<entry, N> const &entries) {
+    std::array<std::uint64_t, N> hashes{};
+    std::array<std::size_t, buckets + 1> first{}; // of each bucket in members
+    for (std::size_t i = 0; i < N; ++i) {
+      hashes[i] = detail::registry_hash(entries[i].first);
+      for (std::size_t j = 0; j < i; ++j)
+        if (hashes[j] == hashes[i] && entries[j].first == entries[i].first)
+          throw std::logic_error{"static_registry: duplicate key"};
+      ++first[hashes[i] % buckets + 1];
+    }
+    for (std::size_t b = 0; b < buckets; ++b)
+      first[b + 1] += first[b];
+    std::array<std::size_t, N> members{};
+    auto fill = first;
+    for (std::size_t i = 0; i < N; ++i)
+      members[fill[hashes[i] % buckets]++] = i;
+
+    // largest buckets first, while most slots are still free
+    std::array<std::size_t, buckets> order{};
+    for (std::size_t b = 0; b < buckets; ++b)
+      order[b] = b;
+    auto const count = [&first](std::size_t b) {
+      return first[b + 1] - first[b];
+    };
+    std::sort(order.begin(), order.end(),
+              [&count](auto a, auto b) { return count(a) > count(b); });
+    for (auto const b : order) {
+      if (count(b) == 0)
+        break;
+      auto const *const begin = members.data() + first[b];
+      auto const *const end = members.data() + first[b + 1];
+      for (std::uint32_t seed = 1;; ++seed) {
+        if (seed == 0)
+          throw std::logic_error{"static_registry: no perfect hash found"};
+        if (try_place(entries, hashes, begin, end, seed)) {
+          seeds_[b] = seed;
+          break;
+        }
+      }
+    }
+  }
+
+  [[nodiscard]] constexpr V const *find(std::string_view key) const noexcept {
+    auto const h = detail::registry_hash(key);
+    auto const s = detail::registry_rehash(h, seeds_[h % buckets]) &
+                   (capacity - 1);
+    return used_[s] && keys_[s] == key ? &values_[s] : nullptr;
+  }
+  [[nodiscard]] constexpr bool contains(std::string_view key) const noexcept {
+    return find(key) != nullptr;
+  }
+  [[nodiscard]] static constexpr std::size_t size() noexcept { return N; }
+
+private:
+  // places all keys of one bucket or none of them
+  constexpr bool try_place(std::array<entry, N> const &entries,
+                           std::array<std::uint64_t, N> const &hashes,
+                           std::size_t const *begin, std::size_t const *end,
+                           std::uint32_t seed) {
+    for (auto const *i = begin; i != end; ++i) {
+      auto const s = detail::registry_rehash(hashes[*i], seed) & (capacity - 1);
+      if (used_[s]) {
+        for (auto const *j = begin; j != i; ++j)
+          used_[detail::registry_rehash(hashes[*j], seed) & (capacity - 1)] =
+              false;
+        return false;
+      }
+      used_[s] = true;
+      keys_[s] = entries[*i].first;
+      values_[s] = entries[*i].second;
+    }
+    return true;
+  }
+
+  std::array<std::uint32_t, buckets> seeds_{};
+  std::array<bool, capacity> used_{};
+  std::array<std::string_view, capacity> keys_{};
+  std::array<V, capacity> values_{};
+};
+
+/*!
+ * \brief make_static_registry
+ *                          Builds a static_registry from a braced list, in a
+ *                          constexpr context the perfect hash is searched at
+ *                          compile time and a duplicate key fails the build:
+ *
+ *   constexpr auto r = make_static_registry<int>({{"a", 1}, {"b", 2}});
+ */
+template <typename V, std::size_t N>
+constexpr auto
+make_static_registry(std::pair<std::string_view, V> const (&entries)[N]) {
+  std::array<std::pair<std::string_view, V>, N> array{};
+  std::copy(entries, entries + N, array.begin());
+  return static_registry<V, N>{array};
+}
+
+} // namespace Tesseract
@@ -0,0 +1,552 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cassert>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <optional>
+#include <thread>
+#include <type_traits>
+#include <utility>
+
+namespace Tesseract {
+
+/*
+Bounded lock-free queues between pipeline stages, meant for frame handles
+(pool_ptr, unique_ptr, indices) that are moved through, never for the frame
+data itself:
+
+  spsc_ring   one producer and one consumer thread, each index is written by
+              one side only and lives on its own cache line together with
+              that side's cached copy of the other index, so a push or pop
+              touches shared memory only when the cached copy runs out.
+              Batch push and pop publish many elements with one store
+  mpmc_ring   any number of producers and consumers, a sequence number per
+              slot as in Vyukov's bounded queue, slots are padded to a cache
+              line
+
+try_push and try_pop never block. push and pop wait while the queue is full
+or empty, how is up to the wait strategy:
+
+  spin_wait   busy waiting with a pause instruction, lowest latency
+  yield_wait  gives the core away between polls
+  futex_wait  spins briefly and then sleeps in the kernel (C++20 atomic wait,
+              a futex on Linux), the other side only makes a system call if
+              someone actually sleeps
+
+With Instrumented = true a queue counts pushes, pops, full and empty hits,
+its high water mark and the time every element spent in the queue.
+*/
+
+inline constexpr std::size_t cache_line = 64;
+
+namespace detail {
+
+inline void cpu_relax() noexcept {
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_ia32_pause();
+#elif defined(__aarch64__)
+  asm volatile("yield");
+#endif
+}
+
+inline std::uint64_t now_ns() noexcept {
+  return static_cast<std::uint64_t>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(
+          std::chrono::steady_clock::now().time_since_epoch())
+          .count());
+}
+
+// written by one thread, read by any
+template <typename T> void bump(std::atomic<T> &counter, T by = 1) noexcept {
+  counter.store(counter.load(std::memory_order_relaxed) + by,
+                std::memory_order_relaxed);
+}
+
+} // namespace detail
+
+/*
+A wait strategy has wait(word, old), which returns once word is no longer old
+or earlier, callers check again anyway, and notify(word), called after every
+change of word. blocking tells whether wait can sleep and therefore needs the
+notifications.
+*/
+
+struct spin_wait {
+  static constexpr bool blocking = false;
+  template <typename Word, typename V>
+  void wait(Word const &, V) const noexcept {
+    detail::cpu_relax();
+  }
+  template <typename Word> void notify(Word &) const noexcept {}
+};
+
+struct yield_wait {
+  static constexpr bool blocking = false;
+  template <typename Word, typename V>
+  void wait(Word const &, V) const noexcept {
+    std::this_thread::yield();
+  }
+  template <typename Word> void notify(Word &) const noexcept {}
+};
+
+class futex_wait {
+public:
+  static constexpr bool blocking = true;
+
+  template <typename Word, typename V>
+  void wait(Word const &word, V old) noexcept {
+    for (auto i = 0; i < 64; ++i) {
+      if (word.load(std::memory_order_acquire) != old)
+        return;
+      detail::cpu_relax();
+    }
+    // pairs with the fence in notify: either this load sees the new value or
+    // the notifier sees the waiter
+    waiters_.fetch_add(1, std::memory_order_seq_cst);
+    word.wait(old, std::memory_order_seq_cst);
+    waiters_.fetch_sub(1, std::memory_order_relaxed);
+  }
+
+  template <typename Word> void notify(Word &word) noexcept {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (waiters_.load(std::memory_order_relaxed) != 0)
+      word.notify_all();
+  }
+
+private:
+  std::atomic<std::uint32_t> waiters_{0};
+};
+
+struct queue_stats {
+  std::uint64_t pushed{0};
+  std::uint64_t popped{0};
+  std::uint64_t full{0};  // push attempts that found the queue full
+  std::uint64_t empty{0}; // pop attempts that found the queue empty
+  std::uint64_t high_water{0};
+  // time between push and pop, log2 buckets: bucket b counts latencies in
+  // [2^b, 2^(b + 1)) nanoseconds
+  std::array<std::uint64_t, 64> latency{};
+
+  // upper bound of the latency that fraction p of all elements stayed below
+  [[nodiscard]] std::uint64_t latency_percentile(double p) const noexcept {
+    auto total = std::uint64_t{0};
+    for (auto const n : latency)
+      total += n;
+    auto seen = std::uint64_t{0};
+    for (std::size_t b = 0; b < latency.size(); ++b) {
+      seen += latency[b];
+      if (seen > 0 &&
+          static_cast<double>(seen) >= p * static_cast<double>(total))
+        return b + 1 < 64 ? std::uint64_t{1} << (b + 1) : ~std::uint64_t{0};
+    }
+    return 0;
+  }
+};
+
+namespace detail {
+
+// counters of one side of a queue, on that side's cache line
+struct side_counters {
+  std::atomic<std::uint64_t> events{0}; // pushes or pops
+  std::atomic<std::uint64_t> misses{0}; // full or empty
+  std::atomic<std::uint64_t> high_water{0};
+  std::array<std::atomic<std::uint64_t>, 64> latency{};
+
+  void record_latency(std::uint64_t since) noexcept {
+    auto const ns = now_ns() - since;
+    auto const b = ns ? std::bit_width(ns) - 1 : 0;
+    latency[static_cast<std::size_t>(b)].fetch_add(1,
+                                                   std::memory_order_relaxed);
+  }
+};
+
+struct no_counters {};
+
+// slot storage, the element is alive only between push and pop
+template <typename T, bool Instrumented> struct slot_storage {
+  alignas(T) std::byte bytes[sizeof(T)];
+
+  T *get() noexcept { return std::launder(reinterpret_cast<T *>(bytes)); }
+};
+
+template <typename T> struct slot_storage<T, true> : slot_storage<T, false> {
+  std::uint64_t pushed_at;
+};
+
+} // namespace detail
+
+/*!
+ * \brief spsc_ring         Single producer single consumer ring
+ * \tparam Wait             spin_wait, yield_wait or futex_wait
+ * \param capacity          Rounded up to a power of two
+ */
+template <typename T, typename Wait = spin_wait, bool Instrumented = false>
+class spsc_ring {
+  using slot = detail::slot_storage<T, Instrumented>;
+  using counters = std::conditional_t<Instrumented, detail::side_counters,
+                                      detail::no_counters>;
+
+public:
+  explicit spsc_ring(std::size_t capacity)
+      : mask_{std::bit_ceil(std::max<std::size_t>(capacity, 2)) - 1},
+        slots_{std::make_unique<slot[]>(mask_ + 1)} {}
+  spsc_ring(spsc_ring const &) = delete;
+  spsc_ring &operator=(spsc_ring const &) = delete;
+
+  ~spsc_ring() {
+    for (auto i = head_.load(); i != tail_.load(); ++i)
+      std::destroy_at(slots_[i & mask_].get());
+  }
+
+  [[nodiscard]] std::size_t capacity() const noexcept { return mask_ + 1; }
+  // exact only when neither side is busy
+  [[nodiscard]] std::size_t size() const noexcept {
+    return tail_.load(std::memory_order_acquire) -
+           head_.load(std::memory_order_acquire);
+  }
+
+  template <typename... Args> bool try_emplace(Args &&... args) {
+    auto const tail = tail_.load(std::memory_order_relaxed);
+    if (tail - head_cache_ == capacity()) {
+      head_cache_ = head_.load(std::memory_order_acquire);
+      if (tail - head_cache_ == capacity()) {
+        count_miss(producer_);
+        return false;
+      }
+    }
+    construct(tail, std::forward<Args>(args)...);
+    publish_tail(tail + 1);
+    return true;
+  }
+  bool try_push(T &&value) { return try_emplace(std::move(value)); }
+
+  /*!
+   * \brief try_push_n      Moves as many elements as fit, up to n, out of the
+   *                        range starting at first, published at once
+   * \return                Number of elements moved
+   */
+  template <typename It> std::size_t try_push_n(It first, std::size_t n) {
+    auto const tail = tail_.load(std::memory_order_relaxed);
+    if (capacity() - (tail - head_cache_) < n)
+      head_cache_ = head_.load(std::memory_order_acquire);
+    n = std::min(n, capacity() - (tail - head_cache_));
+    if (n == 0) {
+      count_miss(producer_);
+      return 0;
+    }
+    for (std::size_t i = 0; i < n; ++i, ++first)
+      construct(tail + i, std::move(*first));
+    publish_tail(tail + n);
+    return n;
+  }
+
+  // waits while the ring is full
+  void push(T value) {
+    for (;;) {
+      auto const head = head_.load(std::memory_order_acquire);
+      if (try_push(std::move(value)))
+        return;
+      not_full_.wait(head_, head);
+    }
+  }
+
+  std::optional<T> try_pop() {
+    auto const head = head_.load(std::memory_order_relaxed);
+    if (head == tail_cache_) {
+      tail_cache_ = tail_.load(std::memory_order_acquire);
+      if (head == tail_cache_) {
+        count_miss(consumer_);
+        return std::nullopt;
+      }
+    }
+    auto value = std::optional<T>{take(head)};
+    publish_head(head + 1);
+    return value;
+  }
+
+  /*!
+   * \brief try_pop_n       Moves up to max elements to out, freeing their
+   *                        slots at once
+   * \return                Number of elements moved
+   */
+  template <typename OutIt> std::size_t try_pop_n(OutIt out, std::size_t max) {
+    auto const head = head_.load(std::memory_order_relaxed);
+    if (tail_cache_ - head < max)
+      tail_cache_ = tail_.load(std::memory_order_acquire);
+    auto const n = std::min(max, tail_cache_ - head);
+    if (n == 0) {
+      count_miss(consumer_);
+      return 0;
+    }
+    for (std::size_t i = 0; i < n; ++i, ++out)
+      *out = take(head + i);
+    publish_head(head + n);
+    return n;
+  }
+
+  // waits while the ring is empty
+  T pop() {
+    for (;;) {
+      auto const tail = tail_.load(std::memory_order_acquire);
+      if (auto value = try_pop())
+        return std::move(*value);
+      not_empty_.wait(tail_, tail);
+    }
+  }
+
+  // waits for at least one element, then takes up to max
+  template <typename OutIt> std::size_t pop_n(OutIt out, std::size_t max) {
+    for (;;) {
+      auto const tail = tail_.load(std::memory_order_acquire);
+      if (auto const n = try_pop_n(out, max))
+        return n;
+      not_empty_.wait(tail_, tail);
+    }
+  }
+
+  // a snapshot, the counters are not read atomically as a whole
+  [[nodiscard]] queue_stats stats() const noexcept
+    requires Instrumented
+  {
+    auto s = queue_stats{};
+    s.pushed = producer_.events.load(std::memory_order_relaxed);
+    s.full = producer_.misses.load(std::memory_order_relaxed);
+    s.high_water = producer_.high_water.load(std::memory_order_relaxed);
+    s.popped = consumer_.events.load(std::memory_order_relaxed);
+    s.empty = consumer_.misses.load(std::memory_order_relaxed);
+    for (std::size_t b = 0; b < s.latency.size(); ++b)
+      s.latency[b] = consumer_.latency[b].load(std::memory_order_relaxed);
+    return s;
+  }
+
+private:
+  template <typename... Args>
+  void construct(std::size_t index, Args &&... args) {
+    auto &s = slots_[index & mask_];
+    ::new (static_cast<void *>(s.bytes)) T(std::forward<Args>(args)...);
+    if constexpr (Instrumented)
+      s.pushed_at = detail::now_ns();
+  }
+
+  T take(std::size_t index) {
+    auto &s = slots_[index & mask_];
+    auto value = T(std::move(*s.get()));
+    std::destroy_at(s.get());
+    if constexpr (Instrumented)
+      consumer_.record_latency(s.pushed_at);
+    return value;
+  }
+
+  void publish_tail(std::size_t tail) {
+    if constexpr (Instrumented) {
+      auto const n = tail - tail_.load(std::memory_order_relaxed);
+      detail::bump<std::uint64_t>(producer_.events, n);
+      // head_cache_ is only refreshed when the ring looks full
+      auto const size = tail - head_.load(std::memory_order_relaxed);
+      if (size > producer_.high_water.load(std::memory_order_relaxed))
+        producer_.high_water.store(size, std::memory_order_relaxed);
+    }
+    tail_.store(tail, std::memory_order_release);
+    not_empty_.notify(tail_);
+  }
+
+  void publish_head(std::size_t head) {
+    if constexpr (Instrumented)
+      detail::bump<std::uint64_t>(consumer_.events,
+                                  head - head_.load(std::memory_order_relaxed));
+    head_.store(head, std::memory_order_release);
+    not_full_.notify(head_);
+  }
+
+  void count_miss([[maybe_unused]] counters &side) noexcept {
+    if constexpr (Instrumented)
+      detail::bump<std::uint64_t>(side.misses);
+  }
+
+  std::size_t const mask_;
+  std::unique_ptr<slot[]> const slots_;
+
+  // producer side
+  alignas(cache_line) std::atomic<std::size_t> tail_{0};
+  std::size_t head_cache_{0};
+  [[no_unique_address]] counters producer_;
+
+  // consumer side
+  alignas(cache_line) std::atomic<std::size_t> head_{0};
+  std::size_t tail_cache_{0};
+  [[no_unique_address]] counters consumer_;
+
+  // the waiting side writes, the other one reads on every push or pop
+  alignas(cache_line) Wait not_full_;
+  alignas(cache_line) Wait not_empty_;
+  alignas(cache_line) std::byte end_padding_{};
+};
+
+/*!
+ * \brief mpmc_ring         Multi producer multi consumer ring, lock-free but
+ *                          a slot is only free again once the consumer that
+ *                          claimed it has moved the element out
+ * \param capacity          Rounded up to a power of two
+ */
+template <typename T, typename Wait = spin_wait, bool Instrumented = false>
+class mpmc_ring {
+  struct alignas(cache_line) cell : detail::slot_storage<T, Instrumented> {
+    std::atomic<std::size_t> sequence;
+  };
+  using counters = std::conditional_t<Instrumented, detail::side_counters,
+                                      detail::no_counters>;
+
+public:
+  explicit mpmc_ring(std::size_t capacity)
+      : mask_{std::bit_ceil(std::max<std::size_t>(capacity, 2)) - 1},
+        cells_{std::make_unique<cell[]>(mask_ + 1)} {
+    for (std::size_t i = 0; i <= mask_; ++i)
+      cells_[i].sequence.store(i, std::memory_order_relaxed);
+  }
+  mpmc_ring(mpmc_ring const &) = delete;
+  mpmc_ring &operator=(mpmc_ring const &) = delete;
+
+  ~mpmc_ring() {
+    for (auto i = dequeue_.load(); i != enqueue_.load(); ++i)
+      std::destroy_at(cells_[i & mask_].get());
+  }
+
+  [[nodiscard]] std::size_t capacity() const noexcept { return mask_ + 1; }
+  // claimed slots, exact only when no thread is busy
+  [[nodiscard]] std::size_t size() const noexcept {
+    auto const tail = enqueue_.load(std::memory_order_acquire);
+    auto const head = dequeue_.load(std::memory_order_acquire);
+    return tail > head ? tail - head : 0;
+  }
+
+  template <typename... Args> bool try_emplace(Args &&... args) {
+    auto pos = enqueue_.load(std::memory_order_relaxed);
+    cell *c;
+    for (;;) {
+      c = &cells_[pos & mask_];
+      auto const seq = c->sequence.load(std::memory_order_acquire);
+      auto const dif =
+          static_cast<std::ptrdiff_t>(seq) - static_cast<std::ptrdiff_t>(pos);
+      if (dif == 0) {
+        if (enqueue_.compare_exchange_weak(pos, pos + 1,
+                                           std::memory_order_relaxed))
+          break;
+      } else if (dif < 0) {
+        count_miss(producers_);
+        return false;
+      } else {
+        pos = enqueue_.load(std::memory_order_relaxed);
+      }
+    }
+    ::new (static_cast<void *>(c->bytes)) T(std::forward<Args>(args)...);
+    if constexpr (Instrumented) {
+      c->pushed_at = detail::now_ns();
+      producers_.events.fetch_add(1, std::memory_order_relaxed);
+      auto const size = pos + 1 - dequeue_.load(std::memory_order_relaxed);
+      auto high = producers_.high_water.load(std::memory_order_relaxed);
+      while (size > high && !producers_.high_water.compare_exchange_weak(
+                                high, size, std::memory_order_relaxed)) {
+      }
+    }
+    c->sequence.store(pos + 1, std::memory_order_release);
+    if constexpr (Wait::blocking) {
+      published_.fetch_add(1, std::memory_order_release);
+      not_empty_.notify(published_);
+    }
+    return true;
+  }
+  bool try_push(T &&value) { return try_emplace(std::move(value)); }
+
+  std::optional<T> try_pop() {
+    auto pos = dequeue_.load(std::memory_order_relaxed);
+    cell *c;
+    for (;;) {
+      c = &cells_[pos & mask_];
+      auto const seq = c->sequence.load(std::memory_order_acquire);
+      auto const dif = static_cast<std::ptrdiff_t>(seq) -
+                       static_cast<std::ptrdiff_t>(pos + 1);
+      if (dif == 0) {
+        if (dequeue_.compare_exchange_weak(pos, pos + 1,
+                                           std::memory_order_relaxed))
+          break;
+      } else if (dif < 0) {
+        count_miss(consumers_);
+        return std::nullopt;
+      } else {
+        pos = dequeue_.load(std::memory_order_relaxed);
+      }
+    }
+    auto value = std::optional<T>{std::move(*c->get())};
+    std::destroy_at(c->get());
+    if constexpr (Instrumented) {
+      consumers_.events.fetch_add(1, std::memory_order_relaxed);
+      consumers_.record_latency(c->pushed_at);
+    }
+    c->sequence.store(pos + mask_ + 1, std::memory_order_release);
+    if constexpr (Wait::blocking) {
+      consumed_.fetch_add(1, std::memory_order_release);
+      not_full_.notify(consumed_);
+    }
+    return value;
+  }
+
+  // waits while the ring is full
+  void push(T value) {
+    for (;;) {
+      auto const consumed = consumed_.load(std::memory_order_acquire);
+      if (try_push(std::move(value)))
+        return;
+      not_full_.wait(consumed_, consumed);
+    }
+  }
+
+  // waits while the ring is empty
+  T pop() {
+    for (;;) {
+      auto const published = published_.load(std::memory_order_acquire);
+      if (auto value = try_pop())
+        return std::move(*value);
+      not_empty_.wait(published_, published);
+    }
+  }
+
+  [[nodiscard]] queue_stats stats() const noexcept
+    requires Instrumented
+  {
+    auto s = queue_stats{};
+    s.pushed = producers_.events.load(std::memory_order_relaxed);
+    s.full = producers_.misses.load(std::memory_order_relaxed);
+    s.high_water = producers_.high_water.load(std::memory_order_relaxed);
+    s.popped = consumers_.events.load(std::memory_order_relaxed);
+    s.empty = consumers_.misses.load(std::memory_order_relaxed);
+    for (std::size_t b = 0; b < s.latency.size(); ++b)
+      s.latency[b] = consumers_.latency[b].load(std::memory_order_relaxed);
+    return s;
+  }
+
+private:
+  void count_miss([[maybe_unused]] counters &side) noexcept {
+    if constexpr (Instrumented)
+      side.misses.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  std::size_t const mask_;
+  std::unique_ptr<cell[]> const cells_;
+
+  alignas(cache_line) std::atomic<std::size_t> enqueue_{0};
+  alignas(cache_line) std::atomic<std::size_t> dequeue_{0};
+  // only maintained for blocking wait strategies, 32 bit for a plain futex
+  alignas(cache_line) std::atomic<std::uint32_t> published_{0};
+  Wait not_empty_;
+  alignas(cache_line) std::atomic<std::uint32_t> consumed_{0};
+  Wait not_full_;
+  alignas(cache_line) counters producers_;
+  alignas(cache_line) counters consumers_;
+};
+
+} // namespace Tesseract
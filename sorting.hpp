@@ -0,0 +1,446 @@
+#pragma once
+#include "threadPool.hpp"
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <iterator>
+#include <type_traits>
+#include <utility>
+
+namespace Tesseract {
+
+/*
+Pattern-defeating quicksort after Orson Peters: median-of-3 (ninther for big
+ranges) pivots, insertion sort below a cutoff, an early exit for ranges that
+turned out to be already sorted after partitioning, a dedicated partition for
+runs of equal elements and, after log2(n) badly unbalanced partitions,
+heapsort as a guaranteed O(n log n) fallback. For arithmetic keys the
+partitioning is done block-wise without data dependent branches, see
+"BlockQuicksort: How Branch Mispredictions don't affect Quicksort".
+*/
+namespace detail {
+
+inline constexpr std::ptrdiff_t insertion_sort_threshold = 24;
+inline constexpr std::ptrdiff_t ninther_threshold = 128;
+inline constexpr std::ptrdiff_t partial_insertion_sort_limit = 8;
+inline constexpr std::ptrdiff_t block_size = 64;
+
+template <typename I, typename C> void insertion_sort(I begin, I end, C comp) {
+  if (begin == end)
+    return;
+  for (auto cur = std::next(begin); cur != end; ++cur) {
+    auto sift = cur;
+    auto sift_1 = std::prev(cur);
+    if (comp(*sift, *sift_1)) {
+      auto tmp = std::move(*sift);
+      do {
+        *sift-- = std::move(*sift_1);
+      } while (sift != begin && comp(tmp, *--sift_1));
+      *sift = std::move(tmp);
+    }
+  }
+}
+
+// *(begin - 1) has to be a sentinel not greater than any element in range
+template <typename I, typename C>
+void unguarded_insertion_sort(I begin, I end, C comp) {
+  if (begin == end)
+    return;
+  for (auto cur = std::next(begin); cur != end; ++cur) {
+    auto sift = cur;
+    auto sift_1 = std::prev(cur);
+    if (comp(*sift, *sift_1)) {
+      auto tmp = std::move(*sift);
+      do {
+        *sift-- = std::move(*sift_1);
+      } while (comp(tmp, *--sift_1));
+      *sift = std::move(tmp);
+    }
+  }
+}
+
+// gives up as soon as more than a handful of elements had to be moved
+template <typename I, typename C>
+bool partial_insertion_sort(I begin, I end, C comp) {
+  if (begin == end)
+    return true;
+  std::ptrdiff_t moves{0};
+  for (auto cur = std::next(begin); cur != end; ++cur) {
+    auto sift = cur;
+    auto sift_1 = std::prev(cur);
+    if (comp(*sift, *sift_1)) {
+      auto tmp = std::move(*sift);
+      do {
+        *sift-- = std::move(*sift_1);
+      } while (sift != begin && comp(tmp, *--sift_1));
+      *sift = std::move(tmp);
+      moves += cur - sift;
+    }
+    if (moves > partial_insertion_sort_limit)
+      return false;
+  }
+  return true;
+}
+
+template <typename I, typename C> void sort2(I a, I b, C comp) {
+  if (comp(*b, *a))
+    std::iter_swap(a, b);
+}
+
+template <typename I, typename C> void sort3(I a, I b, I c, C comp) {
+  sort2(a, b, comp);
+  sort2(b, c, comp);
+  sort2(a, b, comp);
+}
+
+// Partitions around *begin, elements equal to the pivot go to the right.
+// Returns the final pivot position and whether no element had to be swapped
+template <typename I, typename C>
+std::pair<I, bool> partition_right(I begin, I end, C comp) {
+  auto pivot = std::move(*begin);
+  auto first = begin;
+  auto last = end;
+
+  // the median of 3 guarantees that these loops stay within bounds
+  while (comp(*++first, pivot))
+    ;
+  if (first - 1 == begin)
+    while (first < last && !comp(*--last, pivot))
+      ;
+  else
+    while (!comp(*--last, pivot))
+      ;
+
+  bool const already_partitioned = first >= last;
+  while (first < last) {
+    std::iter_swap(first, last);
+    while (comp(*++first, pivot))
+      ;
+    while (!comp(*--last, pivot))
+      ;
+  }
+
+  auto pivot_pos = first - 1;
+  *begin = std::move(*pivot_pos);
+  *pivot_pos = std::move(pivot);
+  return {pivot_pos, already_partitioned};
+}
+
+template <typename I>
+void swap_offsets(I first, I last, unsigned char const *offsets_l,
+                  unsigned char const *offsets_r, std::size_t num,
+                  bool use_swaps) {
+  if (use_swaps) {
+    // needed if first == last, i.e. both blocks overlap
+    for (std::size_t i = 0; i < num; ++i)
+      std::iter_swap(first + offsets_l[i], last - offsets_r[i]);
+  } else if (num > 0) {
+    // cyclic permutation, one move per element instead of three
+    auto l = first + offsets_l[0];
+    auto r = last - offsets_r[0];
+    auto tmp = std::move(*l);
+    *l = std::move(*r);
+    for (std::size_t i = 1; i < num; ++i) {
+      l = first + offsets_l[i];
+      *r = std::move(*l);
+      r = last - offsets_r[i];
+      *l = std::move(*r);
+    }
+    *r = std::move(tmp);
+  }
+}
+
+// Same contract as partition_right, but the comparison results are only
+// stored as offsets into a block and never branched upon
+template <typename I, typename C>
+std::pair<I, bool> partition_right_branchless(I begin, I end, C comp) {
+  auto pivot = std::move(*begin);
+  auto first = begin;
+  auto last = end;
+
+  while (comp(*++first, pivot))
+    ;
+  if (first - 1 == begin)
+    while (first < last && !comp(*--last, pivot))
+      ;
+  else
+    while (!comp(*--last, pivot))
+      ;
+
+  bool const already_partitioned = first >= last;
+  if (!already_partitioned) {
+    std::iter_swap(first, last);
+    ++first;
+
+    alignas(64) unsigned char offsets_l_storage[block_size];
+    alignas(64) unsigned char offsets_r_storage[block_size];
+    unsigned char *offsets_l = offsets_l_storage;
+    unsigned char *offsets_r = offsets_r_storage;
+    auto offsets_l_base = first;
+    auto offsets_r_base = last;
+    std::size_t num_l = 0, num_r = 0, start_l = 0, start_r = 0;
+
+    while (first < last) {
+      // fill whichever block is empty, split the rest if both are
+      auto const num_unknown = static_cast<std::size_t>(last - first);
+      auto const left_split =
+          num_l == 0 ? (num_r == 0 ? num_unknown / 2 : num_unknown) : 0;
+      auto const right_split = num_r == 0 ? (num_unknown - left_split) : 0;
+
+      auto const fill_l = std::min<std::size_t>(left_split, block_size);
+      for (std::size_t i = 0; i < fill_l; ++i) {
+        offsets_l[num_l] = static_cast<unsigned char>(i);
+        num_l += !comp(*first, pivot);
+        ++first;
+      }
+      auto const fill_r = std::min<std::size_t>(right_split, block_size);
+      for (std::size_t i = 0; i < fill_r; ++i) {
+        offsets_r[num_r] = static_cast<unsigned char>(i + 1);
+        num_r += comp(*--last, pivot);
+      }
+
+      auto const num = std::min(num_l, num_r);
+      swap_offsets(offsets_l_base, offsets_r_base, offsets_l + start_l,
+                   offsets_r + start_r, num, num_l == num_r);
+      num_l -= num;
+      num_r -= num;
+      start_l += num;
+      start_r += num;
+      if (num_l == 0) {
+        start_l = 0;
+        offsets_l_base = first;
+      }
+      if (num_r == 0) {
+        start_r = 0;
+        offsets_r_base = last;
+      }
+    }
+
+    // at most one block has elements left, move them next to the boundary
+    if (num_l) {
+      offsets_l += start_l;
+      while (num_l--)
+        std::iter_swap(offsets_l_base + offsets_l[num_l], --last);
+      first = last;
+    }
+    if (num_r) {
+      offsets_r += start_r;
+      while (num_r--)
+        std::iter_swap(offsets_r_base - offsets_r[num_r], first), ++first;
+      last = first;
+    }
+  }
+
+  auto pivot_pos = first - 1;
+  *begin = std::move(*pivot_pos);
+  *pivot_pos = std::move(pivot);
+  return {pivot_pos, already_partitioned};
+}
+
+// Elements equal to the pivot go to the left, used when the pivot equals the
+// element preceding the range, i.e. when all of [begin, pivot] are equal
+template <typename I, typename C> I partition_left(I begin, I end, C comp) {
+  auto pivot = std::move(*begin);
+  auto first = begin;
+  auto last = end;
+
+  while (comp(pivot, *--last))
+    ;
+  if (last + 1 == end)
+    while (first < last && !comp(pivot, *++first))
+      ;
+  else
+    while (!comp(pivot, *++first))
+      ;
+
+  while (first < last) {
+    std::iter_swap(first, last);
+    while (comp(pivot, *--last))
+      ;
+    while (!comp(pivot, *++first))
+      ;
+  }
+
+  auto pivot_pos = last;
+  *begin = std::move(*pivot_pos);
+  *pivot_pos = std::move(pivot);
+  return pivot_pos;
+}
+
+// breaks up patterns that made the last partition highly unbalanced
+template <typename I> void shuffle_around(I begin, I pivot_pos, I end) {
+  auto const l_size = pivot_pos - begin;
+  auto const r_size = end - (pivot_pos + 1);
+  if (l_size >= insertion_sort_threshold) {
+    std::iter_swap(begin, begin + l_size / 4);
+    std::iter_swap(pivot_pos - 1, pivot_pos - l_size / 4);
+    if (l_size > ninther_threshold) {
+      std::iter_swap(begin + 1, begin + (l_size / 4 + 1));
+      std::iter_swap(begin + 2, begin + (l_size / 4 + 2));
+      std::iter_swap(pivot_pos - 2, pivot_pos - (l_size / 4 + 1));
+      std::iter_swap(pivot_pos - 3, pivot_pos - (l_size / 4 + 2));
+    }
+  }
+  if (r_size >= insertion_sort_threshold) {
+    std::iter_swap(pivot_pos + 1, pivot_pos + (1 + r_size / 4));
+    std::iter_swap(end - 1, end - r_size / 4);
+    if (r_size > ninther_threshold) {
+      std::iter_swap(pivot_pos + 2, pivot_pos + (2 + r_size / 4));
+      std::iter_swap(pivot_pos + 3, pivot_pos + (3 + r_size / 4));
+      std::iter_swap(end - 2, end - (1 + r_size / 4));
+      std::iter_swap(end - 3, end - (2 + r_size / 4));
+    }
+  }
+}
+
+// The left partition is handed to recurse(begin, end, bad_allowed,
+// leftmost), the right one is processed by the loop itself
+template <bool Branchless, typename I, typename C, typename R>
+void pdqsort_loop(I begin, I end, C comp, int bad_allowed, bool leftmost,
+                  R &&recurse) {
+  for (;;) {
+    auto const size = end - begin;
+    if (size < insertion_sort_threshold) {
+      if (leftmost)
+        insertion_sort(begin, end, comp);
+      else
+        unguarded_insertion_sort(begin, end, comp);
+      return;
+    }
+
+    auto const s2 = size / 2;
+    if (size > ninther_threshold) {
+      sort3(begin, begin + s2, end - 1, comp);
+      sort3(begin + 1, begin + (s2 - 1), end - 2, comp);
+      sort3(begin + 2, begin + (s2 + 1), end - 3, comp);
+      sort3(begin + (s2 - 1), begin + s2, begin + (s2 + 1), comp);
+      std::iter_swap(begin, begin + s2);
+    } else {
+      sort3(begin + s2, begin, end - 1, comp);
+    }
+
+    // *(begin - 1) is the pivot of the parent partition and thus not greater
+    // than anything in range, if it equals our pivot then everything equal
+    // to it can be put aside at once and needs no further sorting
+    if (!leftmost && !comp(*(begin - 1), *begin)) {
+      begin = partition_left(begin, end, comp) + 1;
+      continue;
+    }
+
+    auto const [pivot_pos, already_partitioned] =
+        Branchless ? partition_right_branchless(begin, end, comp)
+                   : partition_right(begin, end, comp);
+
+    auto const l_size = pivot_pos - begin;
+    auto const r_size = end - (pivot_pos + 1);
+    if (l_size < size / 8 || r_size < size / 8) {
+      if (--bad_allowed == 0) {
+        std::make_heap(begin, end, comp);
+        std::sort_heap(begin, end, comp);
+        return;
+      }
+      shuffle_around(begin, pivot_pos, end);
+    } else if (already_partitioned &&
+               partial_insertion_sort(begin, pivot_pos, comp) &&
+               partial_insertion_sort(pivot_pos + 1, end, comp)) {
+      return;
+    }
+
+    recurse(begin, pivot_pos, bad_allowed, leftmost);
+    begin = pivot_pos + 1;
+    leftmost = false;
+  }
+}
+
+template <typename I> int log2(I n) {
+  int log{0};
+  while (n >>= 1)
+    ++log;
+  return log;
+}
+
+template <bool Branchless, typename I, typename C>
+void pdqsort(I begin, I end, C comp) {
+  if (end - begin < 2)
+    return;
+  auto recurse = [&comp](auto &&self, I b, I e, int bad,
+                         bool leftmost) -> void {
+    pdqsort_loop<Branchless>(b, e, comp, bad, leftmost,
+                             [&self](I b2, I e2, int bad2, bool left2) {
+                               self(self, b2, e2, bad2, left2);
+                             });
+  };
+  recurse(recurse, begin, end, log2(end - begin), true);
+}
+
+template <typename T, typename C>
+inline constexpr bool is_default_compare =
+    std::is_same_v<C, std::less<>> || std::is_same_v<C, std::less<T>> ||
+    std::is_same_v<C, std::greater<>> || std::is_same_v<C, std::greater<T>>;
+
+// branchless partitioning only pays off for cheap comparisons
+template <typename I, typename C>
+inline constexpr bool use_branchless =
+    std::is_arithmetic_v<typename std::iterator_traits<I>::value_type> &&
+    is_default_compare<typename std::iterator_traits<I>::value_type, C>;
+
+} // namespace detail
+
+/*!
+ * \brief pdqsort                   Unstable O(n log n) sort, O(n) for sorted,
+ *                                  reversed and many-equal-keys inputs
+ * \param first                     Random access iterator to the first and
+ * \param last                      one past the last element to be sorted
+ * \param cmp                       Strict weak ordering
+ */
+template <class RandIt, class Compare = std::less<>>
+void pdqsort(RandIt first, RandIt last, Compare cmp = Compare{}) {
+  detail::pdqsort<detail::use_branchless<RandIt, Compare>>(first, last, cmp);
+}
+
+// forces block partitioning, e.g. for detections compared by a float member
+template <class RandIt, class Compare = std::less<>>
+void pdqsort_branchless(RandIt first, RandIt last, Compare cmp = Compare{}) {
+  detail::pdqsort<true>(first, last, cmp);
+}
+
+/*!
+ * \brief parallel_pdqsort          pdqsort whose left partitions are sorted
+ *                                  as separate tasks once they are bigger
+ *                                  than a per-thread share of the range.
+ *                                  Blocks until the whole range is sorted
+ * \param pool                      Workers to run on, must not be the caller
+ */
+template <class RandIt, class Compare = std::less<>>
+void parallel_pdqsort(thread_pool &pool, RandIt first, RandIt last,
+                      Compare cmp = Compare{}) {
+  constexpr bool branchless = detail::use_branchless<RandIt, Compare>;
+  auto const size = last - first;
+  auto const grain = std::max<std::ptrdiff_t>(
+      std::ptrdiff_t{1} << 14,
+      size / (8 * static_cast<std::ptrdiff_t>(pool.size())));
+  if (size <= grain || pool.size() < 2) {
+    detail::pdqsort<branchless>(first, last, cmp);
+    return;
+  }
+
+  auto group = task_group{pool};
+  auto spawn = [&](auto &&self, RandIt b, RandIt e, int bad,
+                   bool leftmost) -> void {
+    auto const sort = [&cmp, recurse = &self, b, e, bad, leftmost] {
+      detail::pdqsort_loop<branchless>(
+          b, e, cmp, bad, leftmost,
+          [recurse](RandIt b2, RandIt e2, int bad2, bool left2) {
+            (*recurse)(*recurse, b2, e2, bad2, left2);
+          });
+    };
+    if (e - b > grain)
+      group.run(sort);
+    else
+      sort();
+  };
+  spawn(spawn, first, last, detail::log2(size), true);
+  group.wait();
+}
+
+} // namespace Tesseract
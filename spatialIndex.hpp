@@ -0,0 +1,441 @@
+#pragma once
+#include "threadPool.hpp"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <numbers>
+#include <span>
+#include <utility>
+#include <vector>
+
+namespace Tesseract {
+
+/*
+Fixed radius neighbor queries over the detections of a frame, in x and y or
+in range and angle. Points come as structure of arrays, one coordinate array
+per axis, and both indexes keep their own copies sorted such that the points
+of a grid cell or of a tree leaf are adjacent, so a query scans short
+contiguous runs instead of chasing indices:
+
+  uniform_grid   rebuilt every frame by a counting sort into cells as large as
+                 the query radius, a query visits 3 x 3 cells, O(n) to build
+  kd_tree        built once over a static set, median splits along the wider
+                 axis, also answers nearest neighbor queries
+
+An axis_scale turns gates that differ per axis into a circle, e.g. 1 / range
+gate and 1 / angle gate for polar detections and a radius of 1. Batch queries
+return the neighbors of all queries at once in compressed rows.
+*/
+
+/*!
+ * \brief point_set         Not owning structure of arrays view of 2d points,
+ *                          e.g. of a detection list
+ */
+struct point_set {
+  std::span<float const> x;
+  std::span<float const> y;
+
+  [[nodiscard]] std::size_t size() const noexcept {
+    assert(x.size() == y.size());
+    return x.size();
+  }
+};
+
+// distances are measured between (x * scale.x, y * scale.y)
+struct axis_scale {
+  float x{1};
+  float y{1};
+};
+
+/*!
+ * \brief neighbor_lists    Result of a batch query, the indices of the
+ *                          neighbors of query i are [offsets[i],
+ *                          offsets[i + 1]) of indices
+ */
+struct neighbor_lists {
+  std::vector<std::uint32_t> offsets{0};
+  std::vector<std::uint32_t> indices;
+
+  [[nodiscard]] std::size_t size() const noexcept {
+    return offsets.size() - 1;
+  }
+  [[nodiscard]] std::span<std::uint32_t const>
+  operator[](std::size_t i) const noexcept {
+    return {indices.data() + offsets[i], indices.data() + offsets[i + 1]};
+  }
+};
+
+namespace detail {
+
+// runs visit(x, y, emit) for every query, in chunks on the pool if there is
+// one, and stitches the chunks together in query order
+template <typename Visit>
+neighbor_lists batch_neighbors(thread_pool *pool, point_set queries,
+                               Visit const &visit) {
+  auto const collect = [&](std::size_t first, std::size_t last,
+                           neighbor_lists &out) {
+    out.offsets.reserve(last - first + 1);
+    for (auto i = first; i < last; ++i) {
+      visit(queries.x[i], queries.y[i], [&out](std::uint32_t index, float) {
+        out.indices.push_back(index);
+      });
+      out.offsets.push_back(static_cast<std::uint32_t>(out.indices.size()));
+    }
+  };
+  auto const n = queries.size();
+  auto result = neighbor_lists{};
+  auto const chunks = pool ? std::min<std::size_t>(pool->size(), n / 256) : 0;
+  if (chunks <= 1) {
+    collect(0, n, result);
+    return result;
+  }
+  auto parts = std::vector<neighbor_lists>(chunks);
+  {
+    task_group group{*pool};
+    for (std::size_t c = 0; c < chunks; ++c)
+      group.run([&, c] {
+        collect(n * c / chunks, n * (c + 1) / chunks, parts[c]);
+      });
+    group.wait();
+  }
+  auto total = std::size_t{0};
+  for (auto const &part : parts)
+    total += part.indices.size();
+  result.offsets.reserve(n + 1);
+  result.indices.reserve(total);
+  for (auto const &part : parts) {
+    auto const base = static_cast<std::uint32_t>(result.indices.size());
+    for (std::size_t i = 1; i < part.offsets.size(); ++i)
+      result.offsets.push_back(base + part.offsets[i]);
+    result.indices.insert(result.indices.end(), part.indices.begin(),
+                          part.indices.end());
+  }
+  return result;
+}
+
+} // namespace detail
+
+/*!
+ * \brief uniform_grid      Bucket grid over a fixed area for one query
+ *                          radius, rebuilt from scratch for every frame.
+ *                          Points outside the area go into the border cells,
+ *                          results stay exact but queries there get slower
+ * \param x0, y0, x1, y1    Area covered, unscaled
+ * \param radius            Query radius in scaled units
+ */
+class uniform_grid {
+public:
+  uniform_grid(float x0, float y0, float x1, float y1, float radius,
+               axis_scale scale = {})
+      : scale_{scale}, radius_{radius}, x0_{x0 * scale.x}, y0_{y0 * scale.y} {
+    assert(radius > 0 && x1 > x0 && y1 > y0);
+    // at most about a million cells, larger cells only cost query time
+    auto const w = (x1 - x0) * scale.x, h = (y1 - y0) * scale.y;
+    // (a hair larger than the radius, so that rounding never hides a cell)
+    auto const cell =
+        std::max(radius * 1.0001F, std::sqrt(w * h / float(1 << 20)));
+    inv_cell_ = 1 / cell;
+    nx_ = static_cast<std::uint32_t>(w * inv_cell_) + 1;
+    ny_ = static_cast<std::uint32_t>(h * inv_cell_) + 1;
+    start_.resize(std::size_t{nx_} * ny_ + 1);
+  }
+
+  /*!
+   * \brief cartesian       Grid over everything a forward looking sensor
+   *                        sees, x ahead and y to the left, in metres
+   * \param sensor          Radar type with maxRange_, e.g. ARS300
+   */
+  template <typename Sensor>
+  static uniform_grid cartesian(Sensor const &sensor, float radius) {
+    auto const r =
+        static_cast<float>(static_cast<long double>(sensor.maxRange_));
+    return {0, -r, r, r, radius};
+  }
+
+  /*!
+   * \brief polar           Grid over range in metres and azimuth in radians,
+   *                        a neighbor is within range_gate and angle_gate
+   *                        (elliptically). Gates default to one cell of the
+   *                        sensor, numberOfRangeCells over maxRange_
+   * \param fov             Azimuth covered, centered around boresight
+   */
+  template <typename Sensor>
+  static uniform_grid polar(Sensor const &sensor, float range_gate = 0,
+                            float angle_gate = 0.05F,
+                            float fov = std::numbers::pi_v<float>) {
+    auto const r =
+        static_cast<float>(static_cast<long double>(sensor.maxRange_));
+    if (range_gate <= 0)
+      range_gate = r / static_cast<float>(sensor.numberOfRangeCells);
+    return {0, -fov / 2, r, fov / 2, 1,
+            axis_scale{1 / range_gate, 1 / angle_gate}};
+  }
+
+  [[nodiscard]] float radius() const noexcept { return radius_; }
+  [[nodiscard]] std::size_t size() const noexcept { return x_.size(); }
+
+  void rebuild(point_set points) {
+    auto const n = points.size();
+    cell_.resize(n);
+    std::fill(start_.begin(), start_.end(), 0);
+    for (std::size_t i = 0; i < n; ++i) {
+      cell_[i] = cell_of(points.x[i] * scale_.x, points.y[i] * scale_.y);
+      ++start_[cell_[i]];
+    }
+    // ends of the cells, placing backwards turns them into the beginnings
+    for (std::size_t c = 1; c < start_.size(); ++c)
+      start_[c] += start_[c - 1];
+    x_.resize(n);
+    y_.resize(n);
+    id_.resize(n);
+    for (auto i = n; i-- > 0;) {
+      auto const at = --start_[cell_[i]];
+      x_[at] = points.x[i] * scale_.x;
+      y_[at] = points.y[i] * scale_.y;
+      id_[at] = static_cast<std::uint32_t>(i);
+    }
+  }
+
+  /*!
+   * \brief for_each_neighbor
+   *                        Calls f(index, squared scaled distance) for every
+   *                        point within the radius of (x, y), including a
+   *                        point at (x, y) itself, in no particular order
+   */
+  template <typename F>
+  void for_each_neighbor(float x, float y, F &&f) const {
+    x *= scale_.x;
+    y *= scale_.y;
+    auto const c = cell_of(x, y);
+    auto const cx = c % nx_, cy = c / nx_;
+    auto const r2 = radius_ * radius_;
+    for (auto j = cy ? cy - 1 : 0; j <= std::min(cy + 1, ny_ - 1); ++j) {
+      // the three cells of a row are adjacent in the sorted arrays
+      auto const row = std::size_t{j} * nx_;
+      auto const first = start_[row + (cx ? cx - 1 : 0)];
+      auto const last = start_[row + std::min(cx + 1, nx_ - 1) + 1];
+      for (auto i = first; i < last; ++i) {
+        auto const dx = x_[i] - x, dy = y_[i] - y;
+        if (auto const d2 = dx * dx + dy * dy; d2 <= r2)
+          f(id_[i], d2);
+      }
+    }
+  }
+
+  [[nodiscard]] neighbor_lists neighbors(point_set queries) const {
+    return batch(nullptr, queries);
+  }
+  [[nodiscard]] neighbor_lists neighbors(thread_pool &pool,
+                                         point_set queries) const {
+    return batch(&pool, queries);
+  }
+
+private:
+  neighbor_lists batch(thread_pool *pool, point_set queries) const {
+    return detail::batch_neighbors(
+        pool, queries,
+        [this](float x, float y, auto &&emit) {
+          for_each_neighbor(x, y, emit);
+        });
+  }
+
+  // clamped, a point far outside only ever meets points of the border cells
+  [[nodiscard]] std::uint32_t cell_of(float x, float y) const noexcept {
+    auto const fx = std::clamp((x - x0_) * inv_cell_, 0.F, float(nx_ - 1));
+    auto const fy = std::clamp((y - y0_) * inv_cell_, 0.F, float(ny_ - 1));
+    return static_cast<std::uint32_t>(fy) * nx_ +
+           static_cast<std::uint32_t>(fx);
+  }
+
+  axis_scale scale_;
+  float radius_;
+  float x0_, y0_; // scaled
+  float inv_cell_;
+  std::uint32_t nx_, ny_;
+  std::vector<std::uint32_t> start_; // first point of every cell, and the end
+  std::vector<std::uint32_t> cell_;  // of every input point, rebuild only
+  std::vector<float> x_, y_;         // scaled, sorted by cell
+  std::vector<std::uint32_t> id_;    // input index of the sorted points
+};
+
+/*!
+ * \brief kd_tree           Static 2d tree, the nodes are implicit: a node
+ *                          covers a range of the sorted points, splits it in
+ *                          the middle and its children are 2 n and 2 n + 1
+ * \param points            Copied, the tree does not refer to them later
+ * \param leaf_size         Points below which a range is scanned linearly
+ */
+class kd_tree {
+public:
+  explicit kd_tree(point_set points, axis_scale scale = {},
+                   std::size_t leaf_size = 16)
+      : scale_{scale}, leaf_size_{std::max<std::size_t>(leaf_size, 1)} {
+    auto const n = points.size();
+    auto order = std::vector<std::uint32_t>(n);
+    for (std::size_t i = 0; i < n; ++i)
+      order[i] = static_cast<std::uint32_t>(i);
+    x_.resize(n);
+    y_.resize(n);
+    for (std::size_t i = 0; i < n; ++i) {
+      x_[i] = points.x[i] * scale.x;
+      y_[i] = points.y[i] * scale.y;
+    }
+    build(order, 1, 0, n);
+    // leaves become contiguous runs of coordinates
+    auto x = std::vector<float>(n), y = std::vector<float>(n);
+    for (std::size_t i = 0; i < n; ++i) {
+      x[i] = x_[order[i]];
+      y[i] = y_[order[i]];
+    }
+    x_ = std::move(x);
+    y_ = std::move(y);
+    id_ = std::move(order);
+  }
+
+  [[nodiscard]] std::size_t size() const noexcept { return id_.size(); }
+
+  /*!
+   * \brief for_each_neighbor
+   *                        Calls f(index, squared scaled distance) for every
+   *                        point within radius of (x, y), in scaled units
+   */
+  template <typename F>
+  void for_each_neighbor(float x, float y, float radius, F &&f) const {
+    x *= scale_.x;
+    y *= scale_.y;
+    auto const r2 = radius * radius;
+    descend(x, y, [r2] { return r2; },
+            [&](std::size_t first, std::size_t last) {
+              for (auto i = first; i < last; ++i) {
+                auto const dx = x_[i] - x, dy = y_[i] - y;
+                if (auto const d2 = dx * dx + dy * dy; d2 <= r2)
+                  f(id_[i], d2);
+              }
+            });
+  }
+
+  /*!
+   * \brief nearest         Closest point to (x, y) no further than
+   *                        max_distance (scaled), as index and squared scaled
+   *                        distance, {npos, max_distance²} if there is none
+   */
+  [[nodiscard]] std::pair<std::uint32_t, float>
+  nearest(float x, float y,
+          float max_distance = std::numeric_limits<float>::infinity()) const {
+    x *= scale_.x;
+    y *= scale_.y;
+    auto best = std::pair{npos, max_distance * max_distance};
+    descend(x, y, [&best] { return best.second; },
+            [&](std::size_t first, std::size_t last) {
+              for (auto i = first; i < last; ++i) {
+                auto const dx = x_[i] - x, dy = y_[i] - y;
+                if (auto const d2 = dx * dx + dy * dy; d2 < best.second)
+                  best = {id_[i], d2};
+              }
+            });
+    return best;
+  }
+
+  [[nodiscard]] neighbor_lists neighbors(point_set queries,
+                                         float radius) const {
+    return batch(nullptr, queries, radius);
+  }
+  [[nodiscard]] neighbor_lists neighbors(thread_pool &pool, point_set queries,
+                                         float radius) const {
+    return batch(&pool, queries, radius);
+  }
+
+  // nearest point of every query, npos where there is none
+  [[nodiscard]] std::vector<std::uint32_t>
+  nearest(point_set queries,
+          float max_distance = std::numeric_limits<float>::infinity()) const {
+    auto result = std::vector<std::uint32_t>(queries.size());
+    for (std::size_t i = 0; i < queries.size(); ++i)
+      result[i] = nearest(queries.x[i], queries.y[i], max_distance).first;
+    return result;
+  }
+
+  static constexpr auto npos = std::numeric_limits<std::uint32_t>::max();
+
+private:
+  struct split {
+    float value;
+    bool along_y;
+  };
+
+  void build(std::vector<std::uint32_t> &order, std::size_t node,
+             std::size_t first, std::size_t last) {
+    if (last - first <= leaf_size_)
+      return;
+    auto lo_x = x_[order[first]], hi_x = lo_x;
+    auto lo_y = y_[order[first]], hi_y = lo_y;
+    for (auto i = first + 1; i < last; ++i) {
+      lo_x = std::min(lo_x, x_[order[i]]);
+      hi_x = std::max(hi_x, x_[order[i]]);
+      lo_y = std::min(lo_y, y_[order[i]]);
+      hi_y = std::max(hi_y, y_[order[i]]);
+    }
+    auto const along_y = hi_y - lo_y > hi_x - lo_x;
+    auto const &axis = along_y ? y_ : x_;
+    auto const mid = first + (last - first) / 2;
+    std::nth_element(order.begin() + first, order.begin() + mid,
+                     order.begin() + last, [&axis](auto a, auto b) {
+                       return axis[a] < axis[b];
+                     });
+    if (splits_.size() <= node)
+      splits_.resize(2 * node + 2);
+    splits_[node] = {axis[order[mid]], along_y};
+    build(order, 2 * node, first, mid);
+    build(order, 2 * node + 1, mid, last);
+  }
+
+  // depth first, nearer child first, a far child is skipped once the plane
+  // is further away than bound()
+  template <typename Bound, typename Scan>
+  void descend(float x, float y, Bound const &bound, Scan const &scan) const {
+    struct pending {
+      std::size_t node, first, last;
+      float plane2; // squared distance to the splitting plane
+    };
+    pending stack[64]; // depth is log2(size / leaf_size)
+    auto top = 0;
+    stack[top++] = {1, 0, size(), 0};
+    while (top > 0) {
+      auto const [node, first, last, plane2] = stack[--top];
+      if (plane2 > bound())
+        continue;
+      if (last - first <= leaf_size_) {
+        scan(first, last);
+        continue;
+      }
+      auto const mid = first + (last - first) / 2;
+      auto const s = splits_[node];
+      auto const d = (s.along_y ? y : x) - s.value;
+      auto const far = d < 0 ? pending{2 * node + 1, mid, last, d * d}
+                             : pending{2 * node, first, mid, d * d};
+      auto const near = d < 0 ? pending{2 * node, first, mid, plane2}
+                              : pending{2 * node + 1, mid, last, plane2};
+      stack[top++] = far;
+      stack[top++] = near;
+    }
+  }
+
+  neighbor_lists batch(thread_pool *pool, point_set queries,
+                       float radius) const {
+    return detail::batch_neighbors(
+        pool, queries, [this, radius](float x, float y, auto &&emit) {
+          for_each_neighbor(x, y, radius, emit);
+        });
+  }
+
+  axis_scale scale_;
+  std::size_t leaf_size_;
+  std::vector<split> splits_; // by node, leaves and node 0 unused
+  std::vector<float> x_, y_;  // scaled, in tree order
+  std::vector<std::uint32_t> id_;
+};
+
+} // namespace Tesseract
@@ -0,0 +1,148 @@
+#pragma once
+#include <algorithm>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace Tesseract {
+
+/*!
+ * \brief thread_pool       Fixed number of worker threads draining a single
+ *                          task queue. The destructor finishes all queued
+ *                          tasks before the workers are joined
+ * \param threads           Number of workers, defaults to one per core
+ */
+class thread_pool {
+public:
+  explicit thread_pool(unsigned threads = std::max(
+                           1u, std::thread::hardware_concurrency())) {
+    workers_.reserve(threads);
+    for (auto i = 0u; i < threads; ++i)
+      workers_.emplace_back([this] { run(); });
+  }
+
+  thread_pool(thread_pool const &) = delete;
+  thread_pool &operator=(thread_pool const &) = delete;
+
+  ~thread_pool() {
+    {
+      std::lock_guard lock{mutex_};
+      stop_ = true;
+    }
+    cv_.notify_all();
+    for (auto &worker : workers_)
+      worker.join();
+  }
+
+  [[nodiscard]] unsigned size() const noexcept {
+    return static_cast<unsigned>(workers_.size());
+  }
+
+  // fire-and-forget, f must not throw
+  template <typename F> void post(F &&f) {
+    {
+      std::lock_guard lock{mutex_};
+      tasks_.emplace_back(std::forward<F>(f));
+    }
+    cv_.notify_one();
+  }
+
+  template <typename F> [[nodiscard]] auto submit(F &&f) {
+    using R = std::invoke_result_t<std::decay_t<F>>;
+    auto task =
+        std::make_shared<std::packaged_task<R()>>(std::forward<F>(f));
+    auto result = task->get_future();
+    post([task] { (*task)(); });
+    return result;
+  }
+
+private:
+  void run() {
+    for (;;) {
+      std::function<void()> task;
+      {
+        std::unique_lock lock{mutex_};
+        cv_.wait(lock, [this] { return stop_ || !tasks_.empty(); });
+        if (tasks_.empty())
+          return;
+        task = std::move(tasks_.front());
+        tasks_.pop_front();
+      }
+      task();
+    }
+  }
+
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  std::deque<std::function<void()>> tasks_;
+  bool stop_{false};
+  std::vector<std::thread> workers_;
+};
+
+/*!
+ * \brief task_group        Tracks tasks that may spawn further tasks into the
+ *                          same group, so recursive algorithms never block a
+ *                          worker while waiting for their children. wait()
+ *                          must be called from outside the pool and rethrows
+ *                          the first exception of a task, the destructor
+ *                          only waits
+ */
+class task_group {
+public:
+  explicit task_group(thread_pool &pool) : pool_{pool} {}
+  task_group(task_group const &) = delete;
+  task_group &operator=(task_group const &) = delete;
+  ~task_group() { wait_idle(); }
+
+  template <typename F> void run(F &&f) {
+    {
+      std::lock_guard lock{mutex_};
+      ++pending_;
+    }
+    pool_.post([this, f = std::forward<F>(f)]() mutable {
+      auto error = std::exception_ptr{};
+      try {
+        f();
+      } catch (...) {
+        error = std::current_exception();
+      }
+      std::lock_guard lock{mutex_};
+      if (error && !error_)
+        error_ = std::move(error);
+      if (--pending_ == 0)
+        done_.notify_all();
+    });
+  }
+
+  void wait() {
+    wait_idle();
+    std::lock_guard lock{mutex_};
+    if (error_)
+      std::rethrow_exception(std::exchange(error_, nullptr));
+  }
+
+  [[nodiscard]] thread_pool &pool() const noexcept { return pool_; }
+
+private:
+  void wait_idle() {
+    std::unique_lock lock{mutex_};
+    done_.wait(lock, [this] { return pending_ == 0; });
+  }
+
+  thread_pool &pool_;
+  std::mutex mutex_;
+  std::condition_variable done_;
+  std::size_t pending_{0};
+  std::exception_ptr error_; // first exception of a task
+};
+
+} // namespace Tesseract
@@ -0,0 +1,225 @@
+#pragma once
+#include "threadPool.hpp"
+#include "tiffio.h"
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include <zlib.h>
+
+namespace Tesseract {
+
+/*
+Tiled TIFF export of rendered grids. Tiles are cut straight out of the grid
+buffer into a tile sized scratch buffer (TIFF tiles are contiguous, grid rows
+are not) and, with deflate, compressed by zlib outside of libtiff, so that the
+parallel overload can compress many tiles at once on a thread pool while the
+calling thread hands finished tiles to TIFFWriteRawTile in order. Only a
+bounded window of compressed tiles is in flight, a frame is never held twice.
+Every page is one TIFF directory, i.e. frame sequences become multipage files.
+*/
+
+/*!
+ * \brief grid_view         Row major grid of samples, not owning
+ * \param stride            Distance between rows in samples, >= width
+ */
+template <typename T> struct grid_view {
+  T const *data;
+  std::uint32_t width;
+  std::uint32_t height;
+  std::size_t stride;
+
+  grid_view(T const *data, std::uint32_t width, std::uint32_t height,
+            std::size_t stride = 0)
+      : data{data}, width{width}, height{height},
+        stride{stride ? stride : width} {}
+};
+
+struct tiff_options {
+  // positive multiples of 16 as TIFF demands, pages fail otherwise
+  std::uint32_t tile_width{256};
+  std::uint32_t tile_height{256};
+  bool deflate{true};
+  int level{Z_DEFAULT_COMPRESSION};
+  bool big_tiff{false}; // for sequences beyond 4 GiB
+};
+
+/*!
+ * \brief tiff_writer       Multipage tiled TIFF file, one page per call of
+ *                          write_page. Like std::ofstream, failures are
+ *                          reported through the return value and operator
+ *                          bool instead of exceptions
+ */
+class tiff_writer {
+public:
+  explicit tiff_writer(std::string const &path, tiff_options options = {})
+      : tif_{TIFFOpen(path.c_str(), options.big_tiff ? "w8" : "w")},
+        options_{options} {}
+  tiff_writer(tiff_writer const &) = delete;
+  tiff_writer &operator=(tiff_writer const &) = delete;
+  ~tiff_writer() { close(); }
+
+  explicit operator bool() const noexcept { return tif_ != nullptr; }
+  [[nodiscard]] std::uint16_t pages() const noexcept { return page_; }
+
+  void close() {
+    if (tif_)
+      TIFFClose(std::exchange(tif_, nullptr));
+  }
+
+  template <typename T> bool write_page(grid_view<T> grid) {
+    if (!begin_page(grid))
+      return false;
+    auto const tiles = tile_count(grid);
+    auto scratch = std::vector<unsigned char>{};
+    auto packed = std::vector<unsigned char>{};
+    for (std::uint32_t t = 0; t < tiles; ++t)
+      if (!write_tile(t, encode_tile(grid, t, scratch, packed)))
+        return false;
+    return end_page();
+  }
+
+  /*!
+   * \brief write_page      Same file contents, tiles are cut and compressed
+   *                        on the pool, in windows of a few tiles per worker
+   * \param pool            Workers to run on, must not be the caller
+   */
+  template <typename T> bool write_page(thread_pool &pool, grid_view<T> grid) {
+    if (!begin_page(grid))
+      return false;
+    auto const tiles = tile_count(grid);
+    auto const window = std::max<std::uint32_t>(4 * pool.size(), 1);
+    struct slot {
+      std::vector<unsigned char> scratch, packed;
+      std::pair<void const *, std::size_t> tile;
+    };
+    auto slots = std::vector<slot>(std::min(window, tiles));
+    for (std::uint32_t first = 0; first < tiles; first += window) {
+      auto const last = std::min(first + window, tiles);
+      {
+        task_group group{pool};
+        for (auto t = first; t < last; ++t)
+          group.run([&, t] {
+            auto &s = slots[t - first];
+            s.tile = encode_tile(grid, t, s.scratch, s.packed);
+          });
+        group.wait();
+      }
+      for (auto t = first; t < last; ++t)
+        if (!write_tile(t, slots[t - first].tile))
+          return false;
+    }
+    return end_page();
+  }
+
+private:
+  template <typename T> static constexpr std::uint16_t sample_format() {
+    static_assert(std::is_arithmetic_v<T>, "samples have to be numbers");
+    if constexpr (std::is_floating_point_v<T>)
+      return SAMPLEFORMAT_IEEEFP;
+    else if constexpr (std::is_signed_v<T>)
+      return SAMPLEFORMAT_INT;
+    else
+      return SAMPLEFORMAT_UINT;
+  }
+
+  template <typename T>
+  std::uint32_t tile_count(grid_view<T> const &grid) const noexcept {
+    auto const across =
+        (grid.width + options_.tile_width - 1) / options_.tile_width;
+    auto const down =
+        (grid.height + options_.tile_height - 1) / options_.tile_height;
+    return across * down;
+  }
+
+  static constexpr bool valid_tile_size(std::uint32_t n) noexcept {
+    return n != 0 && n % 16 == 0;
+  }
+
+  template <typename T> bool begin_page(grid_view<T> const &grid) {
+    if (!tif_ || grid.width == 0 || grid.height == 0)
+      return false;
+    // libtiff takes 0 and only warns about other sizes
+    if (!valid_tile_size(options_.tile_width) ||
+        !valid_tile_size(options_.tile_height))
+      return false;
+    auto const ok =
+        TIFFSetField(tif_, TIFFTAG_SUBFILETYPE, FILETYPE_PAGE) &&
+        TIFFSetField(tif_, TIFFTAG_PAGENUMBER, page_, 0) &&
+        TIFFSetField(tif_, TIFFTAG_IMAGEWIDTH, grid.width) &&
+        TIFFSetField(tif_, TIFFTAG_IMAGELENGTH, grid.height) &&
+        TIFFSetField(tif_, TIFFTAG_TILEWIDTH, options_.tile_width) &&
+        TIFFSetField(tif_, TIFFTAG_TILELENGTH, options_.tile_height) &&
+        TIFFSetField(tif_, TIFFTAG_SAMPLESPERPIXEL, 1) &&
+        TIFFSetField(tif_, TIFFTAG_BITSPERSAMPLE,
+                     static_cast<int>(8 * sizeof(T))) &&
+        TIFFSetField(tif_, TIFFTAG_SAMPLEFORMAT, sample_format<T>()) &&
+        TIFFSetField(tif_, TIFFTAG_PHOTOMETRIC, PHOTOMETRIC_MINISBLACK) &&
+        TIFFSetField(tif_, TIFFTAG_PLANARCONFIG, PLANARCONFIG_CONTIG) &&
+        TIFFSetField(tif_, TIFFTAG_COMPRESSION,
+                     options_.deflate ? COMPRESSION_ADOBE_DEFLATE
+                                      : COMPRESSION_NONE);
+    return ok;
+  }
+
+  bool end_page() {
+    if (!TIFFWriteDirectory(tif_))
+      return false;
+    ++page_;
+    return true;
+  }
+
+  // returns the bytes to write for tile t, which point into the grid itself
+  // if the tile is one contiguous piece of it and nothing is compressed
+  template <typename T>
+  std::pair<void const *, std::size_t>
+  encode_tile(grid_view<T> const &grid, std::uint32_t t,
+              std::vector<unsigned char> &scratch,
+              std::vector<unsigned char> &packed) const {
+    auto const tw = options_.tile_width, th = options_.tile_height;
+    auto const across = (grid.width + tw - 1) / tw;
+    auto const x0 = t % across * tw, y0 = t / across * th;
+    auto const bytes = std::size_t{tw} * th * sizeof(T);
+    auto const rows = std::min(th, grid.height - y0);
+    auto const cols = std::min(tw, grid.width - x0);
+
+    void const *raw = nullptr;
+    if (tw == grid.width && grid.stride == grid.width && rows == th) {
+      raw = grid.data + std::size_t{y0} * grid.stride;
+    } else {
+      scratch.assign(bytes, 0); // edge tiles are padded with zeros
+      for (std::uint32_t y = 0; y < rows; ++y)
+        std::memcpy(scratch.data() + std::size_t{y} * tw * sizeof(T),
+                    grid.data + (std::size_t{y0} + y) * grid.stride + x0,
+                    cols * sizeof(T));
+      raw = scratch.data();
+    }
+    if (!options_.deflate)
+      return {raw, bytes};
+
+    auto size = compressBound(static_cast<uLong>(bytes));
+    packed.resize(size);
+    if (compress2(packed.data(), &size, static_cast<Bytef const *>(raw),
+                  static_cast<uLong>(bytes), options_.level) != Z_OK)
+      return {nullptr, 0};
+    return {packed.data(), size};
+  }
+
+  bool write_tile(std::uint32_t t, std::pair<void const *, std::size_t> tile) {
+    auto const [data, size] = tile;
+    return data &&
+           TIFFWriteRawTile(tif_, t, const_cast<void *>(data),
+                            static_cast<tmsize_t>(size)) ==
+               static_cast<tmsize_t>(size);
+  }
+
+  TIFF *tif_;
+  tiff_options options_;
+  std::uint16_t page_{0};
+};
+
+} // namespace Tesseract
@@ -0,0 +1,436 @@
+#pragma once
+#include "SI-lib.hpp"
+#include "spatialIndex.hpp"
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <utility>
+#include <vector>
+
+namespace Tesseract {
+
+/*
+Multi target Kalman tracking of detections in x and y. Instead of one filter
+object per track, all tracks live in one tracker as structure of arrays: every
+state component and every entry of the (symmetric, hence upper triangle only)
+covariance is an array over the tracks. Predict and update process the tracks
+in batches of `lanes`, a batch is copied into small local arrays whose
+innermost dimension is the lane, so every step of the matrix algebra is one
+vector operation over the batch and the compiler needs no aliasing proofs.
+
+The motion model fixes the state at compile time, components are ordered by
+derivative and then by axis:
+
+  constant_velocity       x y vx vy          4 x 4 matrices
+  constant_acceleration   x y vx vy ax ay    6 x 6 matrices
+
+Each frame detections are gated by the Mahalanobis distance of the
+innovation, candidates are found with a kd_tree over the detections within
+the radius the gate can reach, and assigned greedily by distance (global
+nearest neighbor). Unassigned detections start tracks, tracks that miss too
+many frames in a row are dropped.
+*/
+
+template <std::size_t R, std::size_t C>
+using fixed_matrix = std::array<std::array<float, C>, R>;
+
+struct constant_velocity {
+  static constexpr std::size_t order = 2; // position and velocity
+};
+
+struct constant_acceleration {
+  static constexpr std::size_t order = 3;
+};
+
+struct tracker_config {
+  Length measurement_noise{0.5L}; // standard deviation of x and y
+  // white acceleration noise for constant_velocity, standard deviation of
+  // the acceleration change per frame for constant_acceleration
+  Acceleration process_noise{2.0L};
+  Velocity initial_velocity_noise{10.0L};
+  Acceleration initial_acceleration_noise{5.0L};
+  float gate{9.21F}; // squared Mahalanobis distance, 99 % for 2 degrees
+  std::uint32_t max_misses{3};
+};
+
+namespace detail {
+
+// F of one frame, a Taylor series per axis
+template <std::size_t Order>
+constexpr fixed_matrix<2 * Order, 2 * Order> transition(float dt) noexcept {
+  fixed_matrix<2 * Order, 2 * Order> f{};
+  for (std::size_t k = 0; k < Order; ++k) {
+    auto term = 1.F;
+    for (std::size_t j = k; j < Order; ++j) {
+      f[2 * k][2 * j] = f[2 * k + 1][2 * j + 1] = term;
+      term *= dt / static_cast<float>(j - k + 1);
+    }
+  }
+  return f;
+}
+
+// Q = G G^T sigma^2 per axis, G being the effect of a noise step on each
+// derivative: (dt^2 / 2, dt) or (dt^2 / 2, dt, 1)
+template <std::size_t Order>
+constexpr fixed_matrix<2 * Order, 2 * Order>
+process_noise(float dt, float sigma) noexcept {
+  std::array<float, Order> g{};
+  g[0] = dt * dt / 2;
+  g[1] = dt;
+  if constexpr (Order == 3)
+    g[2] = 1;
+  fixed_matrix<2 * Order, 2 * Order> q{};
+  for (std::size_t i = 0; i < Order; ++i)
+    for (std::size_t j = 0; j < Order; ++j)
+      q[2 * i][2 * j] = q[2 * i + 1][2 * j + 1] = g[i] * g[j] * sigma * sigma;
+  return q;
+}
+
+} // namespace detail
+
+/*!
+ * \brief kalman_tracker    All tracks of one sensor, see above
+ * \tparam Model            constant_velocity or constant_acceleration
+ */
+template <typename Model = constant_velocity> class kalman_tracker {
+public:
+  static constexpr std::size_t dim = 2 * Model::order;
+  static constexpr std::size_t lanes = 16;
+  static constexpr auto none = std::int32_t{-1};
+
+  explicit kalman_tracker(tracker_config config = {}) : config_{config} {}
+
+  [[nodiscard]] std::size_t size() const noexcept { return id_.size(); }
+
+  // stays with a track for its lifetime, never reused
+  [[nodiscard]] std::uint32_t id(std::size_t track) const noexcept {
+    return id_[track];
+  }
+  // frames with a detection since the track started
+  [[nodiscard]] std::uint32_t hits(std::size_t track) const noexcept {
+    return hits_[track];
+  }
+
+  [[nodiscard]] Length x(std::size_t track) const noexcept {
+    return Length{x_[0][track]};
+  }
+  [[nodiscard]] Length y(std::size_t track) const noexcept {
+    return Length{x_[1][track]};
+  }
+  [[nodiscard]] Velocity vx(std::size_t track) const noexcept {
+    return Velocity{x_[2][track]};
+  }
+  [[nodiscard]] Velocity vy(std::size_t track) const noexcept {
+    return Velocity{x_[3][track]};
+  }
+  [[nodiscard]] Acceleration ax(std::size_t track) const noexcept
+    requires(Model::order > 2)
+  {
+    return Acceleration{x_[4][track]};
+  }
+  [[nodiscard]] Acceleration ay(std::size_t track) const noexcept
+    requires(Model::order > 2)
+  {
+    return Acceleration{x_[5][track]};
+  }
+
+  // one state component, or covariance entry (i, j), of all tracks
+  [[nodiscard]] std::span<float const> state(std::size_t i) const noexcept {
+    return x_[i];
+  }
+  [[nodiscard]] std::span<float const>
+  covariance(std::size_t i, std::size_t j) const noexcept {
+    return p_[tri(i, j)];
+  }
+
+  // detection each track was updated with by the last update(), or none
+  [[nodiscard]] std::span<std::int32_t const> assignment() const noexcept {
+    return assigned_;
+  }
+
+  void predict(Time dt) {
+    auto const t = static_cast<float>(static_cast<long double>(dt));
+    auto const f = detail::transition<Model::order>(t);
+    auto const q = detail::process_noise<Model::order>(
+        t, static_cast<float>(static_cast<long double>(config_.process_noise)));
+    for (std::size_t first = 0; first < size(); first += lanes) {
+      batch b;
+      load(b, first);
+      float a[dim][dim][lanes]; // F P
+      for (std::size_t i = 0; i < dim; ++i)
+        for (std::size_t j = 0; j < dim; ++j) {
+          for (std::size_t l = 0; l < lanes; ++l)
+            a[i][j][l] = 0;
+          for (std::size_t k = 0; k < dim; ++k)
+            for (std::size_t l = 0; l < lanes; ++l)
+              a[i][j][l] += f[i][k] * b.p[k][j][l];
+        }
+      for (std::size_t i = 0; i < dim; ++i)
+        for (std::size_t j = i; j < dim; ++j) {
+          for (std::size_t l = 0; l < lanes; ++l)
+            b.p[i][j][l] = q[i][j];
+          for (std::size_t k = 0; k < dim; ++k)
+            for (std::size_t l = 0; l < lanes; ++l)
+              b.p[i][j][l] += a[i][k][l] * f[j][k];
+        }
+      float x[dim][lanes];
+      for (std::size_t i = 0; i < dim; ++i) {
+        for (std::size_t l = 0; l < lanes; ++l)
+          x[i][l] = 0;
+        for (std::size_t k = 0; k < dim; ++k)
+          for (std::size_t l = 0; l < lanes; ++l)
+            x[i][l] += f[i][k] * b.x[k][l];
+      }
+      for (std::size_t i = 0; i < dim; ++i)
+        for (std::size_t l = 0; l < lanes; ++l)
+          b.x[i][l] = x[i][l];
+      store(b, first);
+    }
+  }
+
+  /*!
+   * \brief update          Gates, assigns and filters one frame of
+   *                        detections, then drops lost tracks and starts new
+   *                        ones from the leftovers
+   * \param detections      Positions in metres
+   */
+  void update(point_set detections) {
+    gate();
+    assign(detections);
+    for (std::size_t first = 0; first < size(); first += lanes)
+      correct(detections, first);
+    retire();
+    start(detections);
+  }
+
+  void step(Time dt, point_set detections) {
+    predict(dt);
+    update(detections);
+  }
+
+private:
+  static constexpr std::size_t tri(std::size_t i, std::size_t j) noexcept {
+    if (i > j)
+      std::swap(i, j);
+    return i * dim - i * (i + 1) / 2 + j;
+  }
+
+  struct batch {
+    float x[dim][lanes];
+    float p[dim][dim][lanes]; // only the upper triangle is kept up to date
+  };
+
+  // the lanes beyond the last track get a harmless identity covariance
+  void load(batch &b, std::size_t first) const noexcept {
+    auto const count = std::min(lanes, size() - first);
+    for (std::size_t i = 0; i < dim; ++i) {
+      for (std::size_t l = 0; l < lanes; ++l)
+        b.x[i][l] = l < count ? x_[i][first + l] : 0.F;
+      for (std::size_t j = i; j < dim; ++j)
+        for (std::size_t l = 0; l < lanes; ++l)
+          b.p[i][j][l] = b.p[j][i][l] =
+              l < count ? p_[tri(i, j)][first + l] : float(i == j);
+    }
+  }
+
+  void store(batch const &b, std::size_t first) noexcept {
+    auto const count = std::min(lanes, size() - first);
+    for (std::size_t i = 0; i < dim; ++i) {
+      for (std::size_t l = 0; l < count; ++l)
+        x_[i][first + l] = b.x[i][l];
+      for (std::size_t j = i; j < dim; ++j)
+        for (std::size_t l = 0; l < count; ++l)
+          p_[tri(i, j)][first + l] = b.p[i][j][l];
+    }
+  }
+
+  // innovation covariance S = H P H^T + R of every track, inverted, and the
+  // Euclidean radius its gate ellipse reaches, from the larger eigenvalue
+  void gate() {
+    auto const n = size();
+    auto const r = measurement_variance();
+    s00_.resize(n);
+    s01_.resize(n);
+    s11_.resize(n);
+    reach_.resize(n);
+    for (std::size_t t = 0; t < n; ++t) {
+      auto const a = p_[tri(0, 0)][t] + r, b = p_[tri(0, 1)][t],
+                 c = p_[tri(1, 1)][t] + r;
+      auto const det = a * c - b * b;
+      s00_[t] = c / det;
+      s01_[t] = -b / det;
+      s11_[t] = a / det;
+      auto const half = (a - c) / 2;
+      reach_[t] = std::sqrt(config_.gate *
+                            ((a + c) / 2 + std::sqrt(half * half + b * b)));
+    }
+  }
+
+  // global nearest neighbor: all gated pairs, best first
+  void assign(point_set detections) {
+    auto const n = size();
+    assigned_.assign(n, none);
+    taken_.assign(detections.size(), 0);
+    if (n == 0 || detections.size() == 0)
+      return;
+    auto const tree = kd_tree{detections};
+    candidates_.clear();
+    for (std::size_t t = 0; t < n; ++t) {
+      auto const px = x_[0][t], py = x_[1][t];
+      tree.for_each_neighbor(px, py, reach_[t], [&](std::uint32_t d, float) {
+        auto const dx = detections.x[d] - px, dy = detections.y[d] - py;
+        auto const m = dx * dx * s00_[t] + 2 * dx * dy * s01_[t] +
+                       dy * dy * s11_[t];
+        if (m <= config_.gate)
+          candidates_.push_back({m, static_cast<std::uint32_t>(t), d});
+      });
+    }
+    std::sort(candidates_.begin(), candidates_.end(),
+              [](auto const &a, auto const &b) {
+                return a.distance < b.distance ||
+                       (a.distance == b.distance &&
+                        (a.track < b.track ||
+                         (a.track == b.track && a.detection < b.detection)));
+              });
+    for (auto const &c : candidates_)
+      if (assigned_[c.track] == none && !taken_[c.detection]) {
+        assigned_[c.track] = static_cast<std::int32_t>(c.detection);
+        taken_[c.detection] = 1;
+      }
+  }
+
+  // K = P H^T S^-1, x += K (z - H x), P -= K H P, only where assigned
+  void correct(point_set detections, std::size_t first) {
+    auto const count = std::min(lanes, size() - first);
+    batch b;
+    load(b, first);
+    float zx[lanes], zy[lanes], i00[lanes], i01[lanes], i11[lanes];
+    bool has[lanes];
+    for (std::size_t l = 0; l < lanes; ++l) {
+      auto const d = l < count ? assigned_[first + l] : none;
+      has[l] = d != none;
+      auto const k = static_cast<std::size_t>(has[l] ? d : 0);
+      zx[l] = has[l] ? detections.x[k] : b.x[0][l];
+      zy[l] = has[l] ? detections.y[k] : b.x[1][l];
+      i00[l] = l < count ? s00_[first + l] : 0.F;
+      i01[l] = l < count ? s01_[first + l] : 0.F;
+      i11[l] = l < count ? s11_[first + l] : 0.F;
+    }
+    float k0[dim][lanes], k1[dim][lanes];
+    for (std::size_t i = 0; i < dim; ++i)
+      for (std::size_t l = 0; l < lanes; ++l) {
+        auto const g = has[l] ? 1.F : 0.F;
+        k0[i][l] = g * (b.p[i][0][l] * i00[l] + b.p[i][1][l] * i01[l]);
+        k1[i][l] = g * (b.p[i][0][l] * i01[l] + b.p[i][1][l] * i11[l]);
+      }
+    for (std::size_t l = 0; l < lanes; ++l) {
+      zx[l] -= b.x[0][l];
+      zy[l] -= b.x[1][l];
+    }
+    for (std::size_t i = 0; i < dim; ++i)
+      for (std::size_t l = 0; l < lanes; ++l)
+        b.x[i][l] += k0[i][l] * zx[l] + k1[i][l] * zy[l];
+    // rows 0 and 1 of P are needed unchanged until the end
+    float p0[dim][lanes], p1[dim][lanes];
+    for (std::size_t j = 0; j < dim; ++j)
+      for (std::size_t l = 0; l < lanes; ++l) {
+        p0[j][l] = b.p[0][j][l];
+        p1[j][l] = b.p[1][j][l];
+      }
+    for (std::size_t i = 0; i < dim; ++i)
+      for (std::size_t j = i; j < dim; ++j)
+        for (std::size_t l = 0; l < lanes; ++l)
+          b.p[i][j][l] -= k0[i][l] * p0[j][l] + k1[i][l] * p1[j][l];
+    store(b, first);
+    for (std::size_t l = 0; l < count; ++l) {
+      misses_[first + l] = has[l] ? 0 : misses_[first + l] + 1;
+      hits_[first + l] += has[l];
+    }
+  }
+
+  // drops lost tracks, the order of the others is kept
+  void retire() {
+    auto kept = std::size_t{0};
+    for (std::size_t t = 0; t < size(); ++t) {
+      if (misses_[t] > config_.max_misses)
+        continue;
+      for (auto &v : x_)
+        v[kept] = v[t];
+      for (auto &v : p_)
+        v[kept] = v[t];
+      id_[kept] = id_[t];
+      hits_[kept] = hits_[t];
+      misses_[kept] = misses_[t];
+      assigned_[kept] = assigned_[t];
+      ++kept;
+    }
+    resize(kept);
+  }
+
+  void start(point_set detections) {
+    auto const r = measurement_variance();
+    auto const v = static_cast<float>(
+        static_cast<long double>(config_.initial_velocity_noise));
+    auto const a = static_cast<float>(
+        static_cast<long double>(config_.initial_acceleration_noise));
+    for (std::size_t d = 0; d < detections.size(); ++d) {
+      if (taken_[d])
+        continue;
+      auto const t = size();
+      resize(t + 1);
+      for (auto &c : x_)
+        c[t] = 0;
+      for (auto &c : p_)
+        c[t] = 0;
+      x_[0][t] = detections.x[d];
+      x_[1][t] = detections.y[d];
+      p_[tri(0, 0)][t] = p_[tri(1, 1)][t] = r;
+      p_[tri(2, 2)][t] = p_[tri(3, 3)][t] = v * v;
+      if constexpr (Model::order > 2)
+        p_[tri(4, 4)][t] = p_[tri(5, 5)][t] = a * a;
+      id_[t] = next_id_++;
+      hits_[t] = 1;
+      misses_[t] = 0;
+      assigned_[t] = static_cast<std::int32_t>(d);
+    }
+  }
+
+  void resize(std::size_t n) {
+    for (auto &v : x_)
+      v.resize(n);
+    for (auto &v : p_)
+      v.resize(n);
+    id_.resize(n);
+    hits_.resize(n);
+    misses_.resize(n);
+    assigned_.resize(n);
+  }
+
+  [[nodiscard]] float measurement_variance() const noexcept {
+    auto const sigma = static_cast<float>(
+        static_cast<long double>(config_.measurement_noise));
+    return sigma * sigma;
+  }
+
+  struct candidate {
+    float distance; // squared Mahalanobis
+    std::uint32_t track;
+    std::uint32_t detection;
+  };
+
+  tracker_config config_;
+  std::array<std::vector<float>, dim> x_;
+  std::array<std::vector<float>, dim * (dim + 1) / 2> p_;
+  std::vector<std::uint32_t> id_, hits_, misses_;
+  std::vector<std::int32_t> assigned_;
+  std::uint32_t next_id_{0};
+  // per frame scratch
+  std::vector<float> s00_, s01_, s11_, reach_; // S^-1 and gate radius
+  std::vector<candidate> candidates_;
+  std::vector<std::uint8_t> taken_;
+};
+
+} // namespace Tesseract
@@ -0,0 +1,293 @@
+#pragma once
+#include <cassert>
+#include <cstddef>
+#include <functional>
+#include <optional>
+#include <span>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace Tesseract {
+
+/*
+Transducers are composable algorithmic transformations that are independent
+of their input source and output sink. A transducer turns a step function
+into another step function, composing them with operator| nests all stages
+into a single object at compile time, hence transduce() runs one loop over
+the input without any intermediate container in between.
+
+A step is called as step(accumulator, input) and returns false as soon as no
+more input is wanted, which gives early termination to take() and friends.
+complete(accumulator) is called once at the end so that buffering steps can
+flush whatever they still hold.
+*/
+
+struct transducer_tag {};
+
+template <typename T>
+inline constexpr bool is_transducer_v =
+    std::is_base_of_v<transducer_tag, std::decay_t<T>>;
+
+namespace detail {
+
+// adapts a classic (accum, input) -> accum reducing function
+template <typename F> struct reducing_step {
+  F f_;
+  template <typename A, typename I> bool operator()(A &acc, I &&input) {
+    acc = std::invoke(f_, std::move(acc), std::forward<I>(input));
+    return true;
+  }
+  template <typename A> void complete(A &) {}
+};
+
+template <typename Next> struct step_base {
+  Next next_;
+  template <typename A> void complete(A &acc) { next_.complete(acc); }
+};
+
+template <typename Outer, typename Inner>
+struct composed : transducer_tag {
+  Outer outer_;
+  Inner inner_;
+  template <typename Next> auto operator()(Next next) const {
+    return outer_(inner_(std::move(next)));
+  }
+};
+
+} // namespace detail
+
+// data flows from left to right, i.e. (filter(p) | map(f)) filters first
+template <typename A, typename B,
+          typename = std::enable_if_t<is_transducer_v<A> && is_transducer_v<B>>>
+constexpr auto operator|(A a, B b) {
+  return detail::composed<A, B>{{}, std::move(a), std::move(b)};
+}
+
+template <typename X, typename... Xs> constexpr auto comp(X x, Xs... xs) {
+  return (std::move(x) | ... | std::move(xs));
+}
+
+namespace detail {
+
+template <typename T> struct map_t : transducer_tag {
+  T fn_;
+  template <typename Next> struct step : step_base<Next> {
+    T fn_;
+    template <typename A, typename I> bool operator()(A &acc, I &&input) {
+      return this->next_(acc, std::invoke(fn_, std::forward<I>(input)));
+    }
+  };
+  template <typename Next> auto operator()(Next next) const {
+    return step<Next>{{std::move(next)}, fn_};
+  }
+};
+
+template <typename T> struct filter_t : transducer_tag {
+  T predicate_;
+  template <typename Next> struct step : step_base<Next> {
+    T predicate_;
+    template <typename A, typename I> bool operator()(A &acc, I &&input) {
+      if (!std::invoke(predicate_, std::as_const(input)))
+        return true;
+      return this->next_(acc, std::forward<I>(input));
+    }
+  };
+  template <typename Next> auto operator()(Next next) const {
+    return step<Next>{{std::move(next)}, predicate_};
+  }
+};
+
+struct take_t : transducer_tag {
+  std::size_t n_;
+  template <typename Next> struct step : step_base<Next> {
+    std::size_t remaining_;
+    template <typename A, typename I> bool operator()(A &acc, I &&input) {
+      if (remaining_ == 0)
+        return false;
+      --remaining_;
+      return this->next_(acc, std::forward<I>(input)) && remaining_ > 0;
+    }
+  };
+  template <typename Next> auto operator()(Next next) const {
+    return step<Next>{{std::move(next)}, n_};
+  }
+};
+
+template <typename T> struct take_while_t : transducer_tag {
+  T predicate_;
+  template <typename Next> struct step : step_base<Next> {
+    T predicate_;
+    template <typename A, typename I> bool operator()(A &acc, I &&input) {
+      return std::invoke(predicate_, std::as_const(input)) &&
+             this->next_(acc, std::forward<I>(input));
+    }
+  };
+  template <typename Next> auto operator()(Next next) const {
+    return step<Next>{{std::move(next)}, predicate_};
+  }
+};
+
+template <typename T> struct dedupe_t : transducer_tag {
+  template <typename Next> struct step : step_base<Next> {
+    std::optional<T> last_;
+    template <typename A, typename I> bool operator()(A &acc, I &&input) {
+      if (last_ && *last_ == input)
+        return true;
+      last_ = input;
+      return this->next_(acc, std::forward<I>(input));
+    }
+  };
+  template <typename Next> auto operator()(Next next) const {
+    return step<Next>{{std::move(next)}, std::nullopt};
+  }
+};
+
+template <typename T, typename F> struct partition_by_t : transducer_tag {
+  using key_t = std::decay_t<std::invoke_result_t<F &, T const &>>;
+  F fn_;
+  template <typename Next> struct step : step_base<Next> {
+    F fn_;
+    std::optional<key_t> key_{};
+    std::vector<T> buffer_{};
+    template <typename A, typename I> bool operator()(A &acc, I &&input) {
+      auto key = std::invoke(fn_, std::as_const(input));
+      if (!buffer_.empty() && key != *key_) {
+        bool const more = this->next_(acc, std::span<T const>{buffer_});
+        buffer_.clear();
+        if (!more)
+          return false;
+      }
+      key_ = std::move(key);
+      buffer_.push_back(std::forward<I>(input));
+      return true;
+    }
+    template <typename A> void complete(A &acc) {
+      if (!buffer_.empty())
+        this->next_(acc, std::span<T const>{buffer_});
+      this->next_.complete(acc);
+    }
+  };
+  template <typename Next> auto operator()(Next next) const {
+    return step<Next>{{std::move(next)}, fn_};
+  }
+};
+
+template <typename T> struct window_t : transducer_tag {
+  std::size_t n_;
+  template <typename Next> struct step : step_base<Next> {
+    std::size_t n_;
+    std::size_t seen_{0};
+    // every input is stored twice, n apart, so that the last n inputs are
+    // always contiguous without shifting the buffer
+    std::vector<T> ring_ = std::vector<T>(2 * n_);
+    template <typename A, typename I> bool operator()(A &acc, I &&input) {
+      auto const pos = seen_ % n_;
+      ring_[pos] = input;
+      ring_[pos + n_] = std::forward<I>(input);
+      if (++seen_ < n_)
+        return true;
+      return this->next_(acc, std::span<T const>{ring_.data() + pos + 1, n_});
+    }
+  };
+  template <typename Next> auto operator()(Next next) const {
+    return step<Next>{{std::move(next)}, n_};
+  }
+};
+
+} // namespace detail
+
+/*!
+ * \brief map               Passes fn(input) downstream
+ */
+template <typename T> auto map(T fn) {
+  return detail::map_t<T>{{}, std::move(fn)};
+}
+
+/*!
+ * \brief filter            Passes only inputs that satisfy the predicate
+ */
+template <typename T> auto filter(T predicate) {
+  return detail::filter_t<T>{{}, std::move(predicate)};
+}
+
+/*!
+ * \brief take              Stops the whole reduction after n inputs
+ */
+inline auto take(std::size_t n) { return detail::take_t{{}, n}; }
+
+/*!
+ * \brief take_while        Stops the whole reduction at the first input that
+ *                          does not satisfy the predicate
+ */
+template <typename T> auto take_while(T predicate) {
+  return detail::take_while_t<T>{{}, std::move(predicate)};
+}
+
+/*!
+ * \brief dedupe            Drops inputs equal to their predecessor
+ * \tparam T                Type of the inputs, the last one is kept as a copy
+ */
+template <typename T> auto dedupe() { return detail::dedupe_t<T>{}; }
+
+/*!
+ * \brief partition_by      Groups consecutive inputs for which fn returns the
+ *                          same value, each group is passed downstream as a
+ *                          std::span<T const> into one reused buffer
+ * \tparam T                Type of the inputs
+ */
+template <typename T, typename F> auto partition_by(F fn) {
+  return detail::partition_by_t<T, F>{{}, std::move(fn)};
+}
+
+/*!
+ * \brief window            Sliding window, once n inputs have been seen every
+ *                          further input passes the last n of them downstream
+ *                          as a contiguous std::span<T const>
+ * \tparam T                Type of the inputs
+ * \param n                 Size of the window, at least 1
+ */
+template <typename T> auto window(std::size_t n) {
+  assert(n > 0);
+  return detail::window_t<T>{{}, n};
+}
+
+/*!
+ * \brief transduce         Runs the input range through the transducer into
+ *                          the reducing function in a single pass
+ * \param xform             Transducer, e.g. filter(p) | map(f) | take(10)
+ * \param fn                Reducing function (accum, input) -> accum
+ * \param init              Initial value of the accumulator
+ * \param range             Anything iterable
+ */
+template <typename X, typename F, typename T, typename R>
+T transduce(X const &xform, F fn, T init, R &&range) {
+  auto step = xform(detail::reducing_step<F>{std::move(fn)});
+  for (auto &&input : range)
+    if (!step(init, std::forward<decltype(input)>(input)))
+      break;
+  step.complete(init);
+  return init;
+}
+
+/*!
+ * \brief into              Appends the transformed range to a container
+ */
+template <typename C, typename X, typename R>
+C &into(C &container, X const &xform, R &&range) {
+  auto push = [](C *c, auto &&x) {
+    c->push_back(std::forward<decltype(x)>(x));
+    return c;
+  };
+  transduce(xform, push, &container, std::forward<R>(range));
+  return container;
+}
+
+// reducing function writing to an output iterator, use like so:
+// transduce(map(f), copy_and_advance, std::back_inserter(v), input);
+inline auto copy_and_advance{[](auto it, auto &&input) {
+  *it = std::forward<decltype(input)>(input);
+  return ++it;
+}};
+
+} // namespace Tesseract
@@ -0,0 +1,370 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <memory_resource>
+#include <new>
+#include <streambuf>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+
+inline void indent(std::ostream &out, size_t position) {
+    std::fill_n(std::ostreambuf_iterator<char>{out}, position, ' ');
+}
+
+template <typename T>
+void draw(const T &x, std::ostream &out, size_t position) {
+    indent(out, position);
+    out << x << '\n'; // no std::endl, flushing is up to the caller
+}
+
+/*
+Same value semantics as the shared_ptr based object_t, but without paying an
+allocation for every int. Models that fit into the inline buffer live inside
+the object itself and are copied by value, bigger ones are put into a
+reference counted block and shared immutably. Instead of a virtual base class
+each model type gets one static table of function pointers, hence there is no
+vptr inside the model and no allocation to hold one.
+
+The shared blocks come from a std::pmr::memory_resource, the default resource
+unless the object is constructed with an allocator, e.g. by a document that
+lives on a frame arena.
+*/
+
+enum class sharing
+{
+    atomic,         // heap models may be shared across threads
+    single_threaded // plain integer reference count, no lock prefix
+};
+
+template <sharing>
+struct ref_count;
+
+template <>
+struct ref_count<sharing::atomic>
+{
+    void retain() noexcept { n_.fetch_add(1, std::memory_order_relaxed); }
+    bool release() noexcept {
+        return n_.fetch_sub(1, std::memory_order_acq_rel) == 1;
+    }
+    std::size_t use_count() const noexcept {
+        return n_.load(std::memory_order_acquire);
+    }
+    std::atomic<std::size_t> n_{1};
+};
+
+template <>
+struct ref_count<sharing::single_threaded>
+{
+    void retain() noexcept { ++n_; }
+    bool release() noexcept { return --n_ == 0; }
+    std::size_t use_count() const noexcept { return n_; }
+    std::size_t n_{1};
+};
+
+template <sharing Sharing = sharing::atomic,
+          std::size_t Capacity = 3 * sizeof(void *)>
+class basic_object_t
+{   // polymorphic object that holds anything implementing a
+    // draw function
+    static_assert(Capacity >= sizeof(void *),
+                  "the buffer has to be able to hold a pointer at least");
+
+ public:
+    using allocator_type = std::pmr::polymorphic_allocator<std::byte>;
+
+    template <typename T, // T models drawable
+              typename = std::enable_if_t<
+                  !std::is_same_v<std::decay_t<T>, basic_object_t>>>
+    basic_object_t(T x) : basic_object_t(std::move(x), allocator_type{}) {}
+
+    // a model that does not fit inline is put into a block from alloc
+    template <typename T,
+              typename = std::enable_if_t<
+                  !std::is_same_v<std::decay_t<T>, basic_object_t>>>
+    basic_object_t(T x, allocator_type alloc) {
+        // sink argument, either moved into the buffer or into a shared block
+        if constexpr (is_small<T>)
+            ::new (static_cast<void *>(storage_)) T(std::move(x));
+        else
+            ::new (static_cast<void *>(storage_)) shared_model<T> *(
+                make_block<T>(alloc.resource(), std::move(x)));
+        vtable_ = &ops<T>::vtable;
+    }
+
+    // copies and moves share or take over the block, whatever its resource
+    basic_object_t(basic_object_t const &other, allocator_type)
+        : basic_object_t(other) {}
+    basic_object_t(basic_object_t &&other, allocator_type) noexcept
+        : basic_object_t(std::move(other)) {}
+
+    basic_object_t(basic_object_t const &other) : vtable_{other.vtable_} {
+        if (vtable_)
+            vtable_->copy(other.storage_, storage_);
+    }
+
+    basic_object_t(basic_object_t &&other) noexcept : vtable_{other.vtable_} {
+        if (vtable_) {
+            vtable_->move(other.storage_, storage_);
+            other.vtable_ = nullptr;
+        }
+    }
+
+    basic_object_t &operator=(basic_object_t const &other) {
+        return *this = basic_object_t(other);
+    }
+
+    basic_object_t &operator=(basic_object_t &&other) noexcept {
+        if (this != &other) {
+            reset();
+            if ((vtable_ = other.vtable_)) {
+                vtable_->move(other.storage_, storage_);
+                other.vtable_ = nullptr;
+            }
+        }
+        return *this;
+    }
+
+    ~basic_object_t() { reset(); }
+
+    friend void draw(const basic_object_t &x, std::ostream &out,
+                     size_t position) {
+        x.vtable_->draw(x.storage_, out, position);
+    }
+
+    // Returns the model if it is of type T, nullptr otherwise
+    template <typename T>
+    T const *target() const noexcept {
+        if (vtable_ != &ops<T>::vtable)
+            return nullptr;
+        if constexpr (is_small<T>)
+            return &ops<T>::get(storage_);
+        else
+            return &ops<T>::get(storage_)->data_;
+    }
+
+    // Number of objects sharing the model, inline models are never shared.
+    // A plain load in single_threaded mode, an acquire load otherwise
+    std::size_t use_count() const noexcept {
+        return vtable_ ? vtable_->use_count(storage_) : 0;
+    }
+    bool unique() const noexcept { return use_count() == 1; }
+
+    /*!
+     * \brief mutate            Copy-on-write access to a model of type T,
+     *                          the model is changed in place if this object
+     *                          is its only owner and cloned first otherwise
+     * \param f                 Called with a T& that may be modified
+     * \return                  False if the object does not hold a T
+     */
+    template <typename T, typename F>
+    bool mutate(F &&f) {
+        if (vtable_ != &ops<T>::vtable)
+            return false;
+        if constexpr (is_small<T>) {
+            std::forward<F>(f)(*std::launder(reinterpret_cast<T *>(storage_)));
+        } else {
+            auto *&block =
+                *std::launder(reinterpret_cast<shared_model<T> **>(storage_));
+            if (block->refs_.use_count() != 1) {
+                auto *clone = make_block<T>(block->resource_, block->data_);
+                ops<T>::destroy_(storage_);
+                block = clone;
+            }
+            std::forward<F>(f)(block->data_);
+        }
+        return true;
+    }
+
+    // Draws a contiguous range, consecutive objects holding the same model
+    // type are handed to a single typed loop, i.e. one indirect call per run
+    static void draw_range(basic_object_t const *first,
+                           basic_object_t const *last, std::ostream &out,
+                           size_t position) {
+        while (first != last) {
+            auto const *vtable = first->vtable_;
+            auto const *run_end =
+                std::find_if(first + 1, last, [vtable](auto const &x) {
+                    return x.vtable_ != vtable;
+                });
+            vtable->draw_run(first, run_end - first, out, position);
+            first = run_end;
+        }
+    }
+
+ private:
+    // only models whose copies never allocate are kept inline, anything
+    // else (strings, nested documents) is cheaper to share than to copy
+    template <typename T>
+    static constexpr bool is_small =
+        sizeof(T) <= Capacity && alignof(T) <= alignof(std::max_align_t) &&
+        std::is_nothrow_copy_constructible_v<T> &&
+        std::is_nothrow_move_constructible_v<T>;
+
+    // a block shared by all copies, the model is only mutated through
+    // mutate() once the block is owned exclusively
+    template <typename T>
+    struct shared_model
+    {
+        ref_count<Sharing> refs_;
+        std::pmr::memory_resource *resource_;
+        T data_;
+    };
+
+    template <typename T, typename U>
+    static shared_model<T> *make_block(std::pmr::memory_resource *resource,
+                                       U &&x) {
+        auto alloc = std::pmr::polymorphic_allocator<shared_model<T>>{resource};
+        auto *block = alloc.allocate(1);
+        try {
+            return ::new (static_cast<void *>(block))
+                shared_model<T>{{}, resource, std::forward<U>(x)};
+        } catch (...) {
+            alloc.deallocate(block, 1);
+            throw;
+        }
+    }
+
+    struct vtable_t
+    {
+        void (*draw)(void const *, std::ostream &, size_t);
+        void (*draw_run)(basic_object_t const *, std::ptrdiff_t,
+                         std::ostream &, size_t);
+        void (*copy)(void const *, void *);
+        void (*move)(void *, void *) noexcept;
+        void (*destroy)(void *) noexcept;
+        std::size_t (*use_count)(void const *) noexcept;
+    };
+
+    template <typename T, bool = is_small<T>>
+    struct ops // T lives inside the buffer
+    {
+        static T const &get(void const *s) noexcept {
+            return *std::launder(static_cast<T const *>(s));
+        }
+        static void draw_(void const *s, std::ostream &out, size_t position) {
+            draw(get(s), out, position);
+        }
+        static void draw_run_(basic_object_t const *x, std::ptrdiff_t n,
+                              std::ostream &out, size_t position) {
+            for (std::ptrdiff_t i = 0; i < n; ++i)
+                draw(get(x[i].storage_), out, position);
+        }
+        static void copy_(void const *src, void *dst) {
+            ::new (dst) T(get(src));
+        }
+        static void move_(void *src, void *dst) noexcept {
+            auto &x = *std::launder(static_cast<T *>(src));
+            ::new (dst) T(std::move(x));
+            x.~T();
+        }
+        static void destroy_(void *s) noexcept {
+            std::launder(static_cast<T *>(s))->~T();
+        }
+        static std::size_t use_count_(void const *) noexcept { return 1; }
+        static constexpr vtable_t vtable{draw_, draw_run_, copy_, move_,
+                                          destroy_, use_count_};
+    };
+
+    template <typename T>
+    struct ops<T, false> // the buffer holds a pointer to a shared block
+    {
+        using block_t = shared_model<T>;
+        static block_t *get(void const *s) noexcept {
+            return *std::launder(static_cast<block_t *const *>(s));
+        }
+        static void draw_(void const *s, std::ostream &out, size_t position) {
+            draw(get(s)->data_, out, position);
+        }
+        static void draw_run_(basic_object_t const *x, std::ptrdiff_t n,
+                              std::ostream &out, size_t position) {
+            for (std::ptrdiff_t i = 0; i < n; ++i)
+                draw(get(x[i].storage_)->data_, out, position);
+        }
+        static void copy_(void const *src, void *dst) {
+            auto *block = get(src);
+            block->refs_.retain();
+            ::new (dst) block_t *(block);
+        }
+        static void move_(void *src, void *dst) noexcept {
+            ::new (dst) block_t *(get(src));
+        }
+        static void destroy_(void *s) noexcept {
+            if (auto *block = get(s); block->refs_.release()) {
+                auto alloc =
+                    std::pmr::polymorphic_allocator<block_t>{block->resource_};
+                std::destroy_at(block);
+                alloc.deallocate(block, 1);
+            }
+        }
+        static std::size_t use_count_(void const *s) noexcept {
+            return get(s)->refs_.use_count();
+        }
+        static constexpr vtable_t vtable{draw_, draw_run_, copy_, move_,
+                                          destroy_, use_count_};
+    };
+
+    void reset() noexcept {
+        if (vtable_)
+            vtable_->destroy(storage_);
+        vtable_ = nullptr;
+    }
+
+    alignas(std::max_align_t) unsigned char storage_[Capacity];
+    vtable_t const *vtable_{nullptr};
+};
+
+using small_object_t = basic_object_t<sharing::atomic>;
+using local_object_t = basic_object_t<sharing::single_threaded>;
+
+/*!
+ * \brief render_buffer     Reusable in-memory output stream. Drawing into it
+ *                          never touches the destination stream, flush_to()
+ *                          hands everything over with a single write and
+ *                          keeps the capacity for the next frame
+ */
+class render_buffer : public std::ostream
+{
+ public:
+    explicit render_buffer(std::size_t reserve = 1 << 16)
+        : std::ostream(nullptr) {
+        sink_.data_.reserve(reserve);
+        rdbuf(&sink_);
+    }
+
+    void flush_to(std::ostream &out) {
+        auto &data = sink_.data_;
+        out.write(data.data(), static_cast<std::streamsize>(data.size()));
+        out.flush();
+        data.clear();
+    }
+
+    std::string_view view() const noexcept { return sink_.data_; }
+
+ private:
+    struct sink_t : std::streambuf
+    {
+        int_type overflow(int_type c) override {
+            if (!traits_type::eq_int_type(c, traits_type::eof()))
+                data_.push_back(traits_type::to_char_type(c));
+            return traits_type::not_eof(c);
+        }
+        std::streamsize xsputn(char const *s, std::streamsize n) override {
+            data_.append(s, static_cast<std::size_t>(n));
+            return n;
+        }
+        std::string data_;
+    } sink_;
+};
+
+template <typename Document>
+void render(const Document &x, std::ostream &out, render_buffer &buffer,
+            size_t position = 0) {
+    draw(x, buffer, position);
+    buffer.flush_to(out);
+}
@@ -0,0 +1,99 @@
+#include "frameArena.hpp"
+#include "persistentVector.hpp"
+#include "typeErasure.hpp"
+#include <cassert>
+#include <iostream>
+#include <memory_resource>
+#include <string>
+
+using object_t = local_object_t; // documents are edited by one thread only
+
+using document_t = persistent_vector<object_t>; // snapshots share nodes
+
+void draw(const document_t &x, std::ostream &out, size_t position) {
+    indent(out, position);
+    out << "<document>\n";
+    x.for_each_chunk([&](object_t const *first, size_t n) {
+        object_t::draw_range(first, first + n, out, position + 2);
+    });
+    indent(out, position);
+    out << "<document>\n";
+}
+
+using history_t = basic_history<document_t>;
+
+void commit(history_t &x) { x.commit(); }
+void undo(history_t &x) { x.undo(); }
+document_t &current(history_t &x) { return x.current(); }
+
+/******************************************************************************/
+// Client
+class my_class_t
+{
+};
+
+void draw(const my_class_t &, std::ostream &out, size_t position) {
+    indent(out, position);
+    out << "my_class_t\n";
+}
+
+int main() {
+    // an int and an empty class are stored inline, no allocation at all
+    static_assert(sizeof(object_t) <= 32);
+
+    history_t h(128); // keep the last 128 snapshots
+    render_buffer buffer;
+
+    current(h).emplace_back(0);
+    current(h).emplace_back(std::string("Hello!"));
+
+    render(current(h), std::cout, buffer);
+    std::cout << "--------------------------" << std::endl;
+
+    commit(h);
+
+    current(h).emplace_back(current(h));
+    current(h).emplace_back(my_class_t());
+    current(h)[0].mutate<int>([](int &i) { i = 42; }); // inline, in place
+    // shared with the committed snapshot, hence cloned before the edit
+    current(h)[1].mutate<std::string>([](std::string &s) { s = "World"; });
+
+    render(current(h), std::cout, buffer);
+    std::cout << "--------------------------" << std::endl;
+
+    undo(h);
+
+    render(current(h), std::cout, buffer);
+
+    // documents are values, assigning one shares its nodes, and the target
+    // is path-copied on its next edit
+    document_t copy;
+    copy = current(h);
+    copy.emplace_back(my_class_t());
+    assert(copy.size() == current(h).size() + 1);
+    copy = document_t{};
+    assert(copy.empty());
+
+    // a document that lives for one frame only takes its nodes and the
+    // blocks of its models from the arena, the default resource, i.e. the
+    // heap, is not touched at all
+    Tesseract::counting_resource heap;
+    std::pmr::set_default_resource(&heap);
+    Tesseract::frame_arena arena;
+    for (int frame = 0; frame < 3; ++frame) {
+        heap.clear();
+        {
+            document_t scene{arena.allocator<object_t>()};
+            for (int i = 0; i < 100; ++i)
+                scene.emplace_back(i);
+            scene.emplace_back(
+                std::pmr::string("frame objects", arena.allocator<char>()));
+            scene.emplace_back(current(h)); // shares the nodes of the history
+            scene[0].mutate<int>([frame](int &i) { i = frame; });
+        }
+        arena.reset();
+        std::cout << "frame " << frame << ": " << heap.allocations()
+                  << " heap allocations\n";
+    }
+    std::pmr::set_default_resource(nullptr); // heap goes out of scope
+}
@@ -0,0 +1,137 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+namespace Tesseract::variadic {
+
+/*
+constexpr algorithms over parameter packs that return plain values rather than
+references into a chain of temporaries, so the optimizer sees straight-line
+code. Homogeneous arithmetic packs are first put into a std::array and reduced
+as a balanced tree of selects, which compiles to min/max/blend instructions
+instead of compare-and-branch sequences. Mixed packs are folded left to right
+in their common type. All of them are usable in constant expressions, the *_v
+variable templates force compile-time evaluation outright.
+*/
+
+template <typename T, typename... Ts>
+inline constexpr bool homogeneous_arithmetic_v =
+    std::is_arithmetic_v<T> && (std::is_same_v<T, Ts> && ...);
+
+namespace detail {
+
+// unrolled at compile time into a balanced tree of independent operations
+template <std::size_t First, std::size_t N, typename T, std::size_t M,
+          typename F>
+constexpr T tree_reduce(std::array<T, M> const &xs, F f) {
+  if constexpr (N == 1)
+    return xs[First];
+  else
+    return f(tree_reduce<First, N / 2>(xs, f),
+             tree_reduce<First + N / 2, N - N / 2>(xs, f));
+}
+
+template <typename T, std::size_t N, typename F>
+constexpr T tree_reduce(std::array<T, N> const &xs, F f) {
+  return tree_reduce<0, N>(xs, f);
+}
+
+inline constexpr auto select_min = [](auto a, auto b) { return b < a ? b : a; };
+inline constexpr auto select_max = [](auto a, auto b) { return a < b ? b : a; };
+
+} // namespace detail
+
+template <typename T, typename... Ts>
+[[nodiscard]] constexpr auto min(T const &t, Ts const &... ts) {
+  if constexpr (homogeneous_arithmetic_v<T, Ts...>) {
+    return detail::tree_reduce(std::array<T, 1 + sizeof...(Ts)>{t, ts...},
+                               detail::select_min);
+  } else {
+    std::common_type_t<T, Ts...> result = t;
+    ((result = detail::select_min(result, ts)), ...);
+    return result;
+  }
+}
+
+template <typename T, typename... Ts>
+[[nodiscard]] constexpr auto max(T const &t, Ts const &... ts) {
+  if constexpr (homogeneous_arithmetic_v<T, Ts...>) {
+    return detail::tree_reduce(std::array<T, 1 + sizeof...(Ts)>{t, ts...},
+                               detail::select_max);
+  } else {
+    std::common_type_t<T, Ts...> result = t;
+    ((result = detail::select_max(result, ts)), ...);
+    return result;
+  }
+}
+
+/*!
+ * \brief argmin            Position of the first smallest argument
+ */
+template <typename T, typename... Ts>
+[[nodiscard]] constexpr std::size_t argmin(T const &t, Ts const &... ts) {
+  std::common_type_t<T, Ts...> best = t;
+  std::size_t index{0}, i{0};
+  // selects instead of branches, both updates are computed unconditionally
+  ((++i, index = ts < best ? i : index, best = ts < best ? ts : best), ...);
+  return index;
+}
+
+/*!
+ * \brief all_within        Checks whether all of ts lie in [min, max], every
+ *                          comparison is evaluated, no short-circuiting
+ */
+template <typename T, typename... Ts>
+[[nodiscard]] constexpr bool all_within(T const &min, T const &max,
+                                        Ts const &... ts) {
+  return (true & ... & ((min <= ts) & (ts <= max)));
+}
+
+// partial sums are promoted like in (t + ... + ts), whichever branch is taken
+template <typename T, typename... Ts>
+[[nodiscard]] constexpr auto sum(T const &t, Ts const &... ts) {
+  if constexpr (homogeneous_arithmetic_v<T, Ts...>) {
+    using R = decltype(t + t);
+    return detail::tree_reduce(
+        std::array<R, 1 + sizeof...(Ts)>{static_cast<R>(t),
+                                         static_cast<R>(ts)...},
+        [](R a, R b) -> R { return a + b; });
+  } else
+    return (t + ... + ts);
+}
+
+namespace detail {
+template <typename A, typename B, std::size_t... I>
+constexpr auto dot(A const &a, B const &b, std::index_sequence<I...>) {
+  using std::get;
+  return sum((get<I>(a) * get<I>(b))...);
+}
+} // namespace detail
+
+/*!
+ * \brief dot               Inner product of two equally sized std::arrays or
+ *                          tuples, expanded at compile time into independent
+ *                          products that are summed as a tree
+ */
+template <typename A, typename B>
+[[nodiscard]] constexpr auto dot(A const &a, B const &b) {
+  constexpr auto N = std::tuple_size_v<A>;
+  static_assert(N == std::tuple_size_v<B>, "dot needs equal sizes");
+  static_assert(N > 0, "dot needs at least one element");
+  return detail::dot(a, b, std::make_index_sequence<N>{});
+}
+
+template <auto... Vs> inline constexpr auto min_v = min(Vs...);
+template <auto... Vs> inline constexpr auto max_v = max(Vs...);
+template <auto... Vs> inline constexpr auto argmin_v = argmin(Vs...);
+template <auto... Vs> inline constexpr auto sum_v = sum(Vs...);
+
+static_assert(min_v<3, 1, 2> == 1 && max_v<3, 1, 2> == 3);
+static_assert(argmin_v<3, 1, 2, 1> == 1 && sum_v<1, 2, 3, 4, 5> == 15);
+static_assert(all_within(0, 10, 1, 5, 10) && !all_within(0, 10, 1, 11));
+static_assert(dot(std::array{1, 2, 3}, std::array{4, 5, 6}) == 32);
+
+} // namespace Tesseract::variadic